@@ -0,0 +1,229 @@
+#include "atlas.h"
+
+#include <cstring>
+
+#include "image_data.h"
+
+namespace PbkitSdlGpu {
+
+// Texels reserved around each surface.
+static constexpr int kPadding = 1;
+
+TextureAtlas::TextureAtlas(uint16_t page_width, uint16_t page_height)
+    : page_width_(page_width), page_height_(page_height) {}
+
+TextureAtlas::~TextureAtlas() {
+  // Images returned by AddSurface hold their own reference to the page texture.
+  for (auto& page : pages_) {
+    GPU_FreeImage(page.image);
+    SDL_FreeSurface(page.staging);
+  }
+}
+
+GPU_Image* TextureAtlas::AddSurface(SDL_Surface* surface) {
+  if (!surface) {
+    GPU_PushErrorCode("PBKitSDLGPUAtlasAddSurface", GPU_ERROR_NULL_ARGUMENT, "surface");
+    return nullptr;
+  }
+
+  int padded_width = surface->w + 2 * kPadding;
+  int padded_height = surface->h + 2 * kPadding;
+  if (padded_width > page_width_ || padded_height > page_height_) {
+    GPU_PushErrorCode("PBKitSDLGPUAtlasAddSurface", GPU_ERROR_USER_ERROR,
+                      "%dx%d surface does not fit in a %dx%d page", surface->w, surface->h,
+                      page_width_, page_height_);
+    return nullptr;
+  }
+
+  Page* page = nullptr;
+  int x, y;
+  size_t node;
+  for (auto& candidate : pages_) {
+    if (FindPosition(candidate, padded_width, padded_height, &x, &y, &node)) {
+      page = &candidate;
+      break;
+    }
+  }
+
+  if (!page) {
+    if (!CreatePage()) {
+      return nullptr;
+    }
+    page = &pages_.back();
+    if (!FindPosition(*page, padded_width, padded_height, &x, &y, &node)) {
+      return nullptr;
+    }
+  }
+
+  // Copy the texels as they are rather than blending them over the cleared page.
+  SDL_BlendMode blend_mode;
+  SDL_GetSurfaceBlendMode(surface, &blend_mode);
+  SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+  SDL_Rect dest_rect = { x + kPadding, y + kPadding, surface->w, surface->h };
+  int result = SDL_BlitSurface(surface, nullptr, page->staging, &dest_rect);
+  SDL_SetSurfaceBlendMode(surface, blend_mode);
+  if (result) {
+    GPU_PushErrorCode("PBKitSDLGPUAtlasAddSurface", GPU_ERROR_DATA_ERROR,
+                      "Failed to copy surface: %s", SDL_GetError());
+    return nullptr;
+  }
+
+  auto image = GPU_CreateAliasImage(page->image);
+  if (!image) {
+    return nullptr;
+  }
+
+  ExtrudeEdges(page->staging, x, y, surface->w, surface->h);
+  AddSkylineLevel(page, node, x, y, padded_width, padded_height);
+  AddDirtyRect(page, { x, y, padded_width, padded_height });
+
+  image->w = surface->w;
+  image->h = surface->h;
+  image->base_w = surface->w;
+  image->base_h = surface->h;
+  auto image_data = (PBKitImageData*)image->data;
+  image_data->offset_x = x + kPadding;
+  image_data->offset_y = y + kPadding;
+  return image;
+}
+
+void TextureAtlas::Upload() {
+  for (auto& page : pages_) {
+    if (page.dirty.w) {
+      GPU_Rect rect = { (float)page.dirty.x, (float)page.dirty.y, (float)page.dirty.w,
+                        (float)page.dirty.h };
+      GPU_UpdateImage(page.image, &rect, page.staging, &rect);
+      page.dirty = { 0, 0, 0, 0 };
+    }
+  }
+}
+
+bool TextureAtlas::CreatePage() {
+  auto image = GPU_CreateImage(page_width_, page_height_, GPU_FORMAT_RGBA);
+  if (!image) {
+    return false;
+  }
+
+  // New surfaces are zero filled, so unused regions of the page are transparent.
+  auto staging = SDL_CreateRGBSurfaceWithFormat(0, page_width_, page_height_, 32,
+                                                SDL_PIXELFORMAT_ABGR8888);
+  if (!staging) {
+    GPU_PushErrorCode("PBKitSDLGPUAtlasAddSurface", GPU_ERROR_BACKEND_ERROR,
+                      "Failed to allocate staging surface: %s", SDL_GetError());
+    GPU_FreeImage(image);
+    return false;
+  }
+
+  pages_.push_back({ image, staging, { { 0, 0, page_width_ } }, { 0, 0, 0, 0 } });
+  return true;
+}
+
+// Finds the lowest position along the skyline that fits a `width` x `height` rectangle, preferring
+// narrower levels on ties. `node` receives the index of the level the rectangle starts on.
+bool TextureAtlas::FindPosition(
+    const Page& page, int width, int height, int* x, int* y, size_t* node) {
+  auto page_width = page.staging->w;
+  auto page_height = page.staging->h;
+  const auto& skyline = page.skyline;
+
+  int best_bottom = page_height + 1;
+  int best_width = page_width + 1;
+  for (size_t i = 0; i < skyline.size(); ++i) {
+    int left = skyline[i].x;
+    if (left + width > page_width) {
+      break;
+    }
+
+    // The rectangle rests on the highest level it spans.
+    int top = 0;
+    for (size_t j = i; j < skyline.size() && skyline[j].x < left + width; ++j) {
+      if (skyline[j].y > top) {
+        top = skyline[j].y;
+      }
+    }
+
+    int bottom = top + height;
+    if (bottom > page_height) {
+      continue;
+    }
+
+    if (bottom < best_bottom || (bottom == best_bottom && skyline[i].width < best_width)) {
+      best_bottom = bottom;
+      best_width = skyline[i].width;
+      *x = left;
+      *y = top;
+      *node = i;
+    }
+  }
+
+  return best_bottom <= page_height;
+}
+
+// Raises the skyline over the rectangle placed at (`x`, `y`) by FindPosition.
+void TextureAtlas::AddSkylineLevel(Page* page, size_t node, int x, int y, int width, int height) {
+  auto& skyline = page->skyline;
+  skyline.insert(skyline.begin() + node, { x, y + height, width });
+
+  // Trim the levels now covered by the new one.
+  for (size_t i = node + 1; i < skyline.size();) {
+    int covered_end = skyline[i - 1].x + skyline[i - 1].width;
+    if (skyline[i].x >= covered_end) {
+      break;
+    }
+
+    int overlap = covered_end - skyline[i].x;
+    if (skyline[i].width <= overlap) {
+      skyline.erase(skyline.begin() + i);
+      continue;
+    }
+
+    skyline[i].x += overlap;
+    skyline[i].width -= overlap;
+    break;
+  }
+
+  for (size_t i = 0; i + 1 < skyline.size();) {
+    if (skyline[i].y == skyline[i + 1].y) {
+      skyline[i].width += skyline[i + 1].width;
+      skyline.erase(skyline.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void TextureAtlas::AddDirtyRect(Page* page, const SDL_Rect& rect) {
+  auto& dirty = page->dirty;
+  if (!dirty.w) {
+    dirty = rect;
+    return;
+  }
+
+  int right = dirty.x + dirty.w > rect.x + rect.w ? dirty.x + dirty.w : rect.x + rect.w;
+  int bottom = dirty.y + dirty.h > rect.y + rect.h ? dirty.y + dirty.h : rect.y + rect.h;
+  dirty.x = dirty.x < rect.x ? dirty.x : rect.x;
+  dirty.y = dirty.y < rect.y ? dirty.y : rect.y;
+  dirty.w = right - dirty.x;
+  dirty.h = bottom - dirty.y;
+}
+
+// Copies the outermost texels of the `width` x `height` surface placed inside the padded slot at
+// (`x`, `y`) into the slot's border.
+void TextureAtlas::ExtrudeEdges(SDL_Surface* staging, int x, int y, int width, int height) {
+  auto pixels = static_cast<uint8_t*>(staging->pixels);
+  auto row = [pixels, staging](int index) {
+    return reinterpret_cast<uint32_t*>(pixels + index * staging->pitch);
+  };
+
+  for (int i = y + kPadding; i < y + kPadding + height; ++i) {
+    auto texels = row(i);
+    texels[x] = texels[x + kPadding];
+    texels[x + kPadding + width] = texels[x + width];
+  }
+
+  size_t padded_row_size = (width + 2 * kPadding) * sizeof(uint32_t);
+  memcpy(row(y) + x, row(y + kPadding) + x, padded_row_size);
+  memcpy(row(y + kPadding + height) + x, row(y + height) + x, padded_row_size);
+}
+
+}  // namespace PbkitSdlGpu
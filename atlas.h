@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SDL_gpu.h"
+
+namespace PbkitSdlGpu {
+
+// Packs many small surfaces into shared swizzled texture pages.
+//
+// Each added surface is returned as an alias of its page whose dimensions are those of the surface
+// and whose image data carries the texel offset of its slot, so blits of the alias are remapped
+// into the page without any change on the caller's side. Blits of images that share a page are
+// batched together since they sample from the same texture.
+//
+// Surfaces are packed bottom-left along a skyline and surrounded by a one texel border that
+// duplicates their edge texels, so that linear filtering does not bleed between neighbors.
+class TextureAtlas {
+ public:
+  TextureAtlas(uint16_t page_width, uint16_t page_height);
+  ~TextureAtlas();
+
+  // Copies `surface` into the atlas, opening a new page if none of the existing ones has room.
+  // Returns nullptr if the surface does not fit in an empty page. The returned image must be freed
+  // with GPU_FreeImage and remains valid after the atlas is destroyed.
+  GPU_Image* AddSurface(SDL_Surface* surface);
+
+  // Sends the regions of each page that were modified since the last call to the GPU. Images
+  // returned by AddSurface have undefined contents until they have been uploaded.
+  void Upload();
+
+ private:
+  struct SkylineNode {
+    int x;
+    int y;
+    int width;
+  };
+
+  struct Page {
+    GPU_Image* image;
+    SDL_Surface* staging;
+    std::vector<SkylineNode> skyline;
+    // Bounds of the slots filled since the last upload, empty if there are none.
+    SDL_Rect dirty;
+  };
+
+  bool CreatePage();
+  static bool FindPosition(const Page& page, int width, int height, int* x, int* y, size_t* node);
+  static void AddSkylineLevel(Page* page, size_t node, int x, int y, int width, int height);
+  static void AddDirtyRect(Page* page, const SDL_Rect& rect);
+  static void ExtrudeEdges(SDL_Surface* staging, int x, int y, int width, int height);
+
+  uint16_t page_width_;
+  uint16_t page_height_;
+  std::vector<Page> pages_;
+};
+
+}  // namespace PbkitSdlGpu
@@ -3,6 +3,7 @@
 #include <pbkit/nv_regs.h>
 #include <pbkit/pbkit.h>
 #include "debug_output.h"
+#include "register_cache.h"
 
 #define MASK(mask, val) (((val) << (__builtin_ffs(mask) - 1)) & (mask))
 #define TO_BGRA(float_vals) \
@@ -10,14 +11,20 @@
    + ((uint32_t)((float_vals)[0] * 255.0f) << 16) \
    + ((uint32_t)((float_vals)[1] * 255.0f) << 8) + ((uint32_t)((float_vals)[2] * 255.0f)))
 
+using PbkitSdlGpu::PushState;
+using PbkitSdlGpu::PushStateN;
+using PbkitSdlGpu::SetState;
+
+static constexpr uint32_t kZeroCombiners[8] = { 0 };
+
 void SetAlphaBlendEnabled(bool enable) {
   auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_BLEND_ENABLE, enable);
+  p = PushState(p, NV097_SET_BLEND_ENABLE, enable);
   if (enable) {
-    p = pb_push1(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
-    p = pb_push1(p, NV097_SET_BLEND_FUNC_SFACTOR, NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA);
-    p = pb_push1(p, NV097_SET_BLEND_FUNC_DFACTOR,
-                 NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA);
+    p = PushState(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
+    p = PushState(p, NV097_SET_BLEND_FUNC_SFACTOR, NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA);
+    p = PushState(p, NV097_SET_BLEND_FUNC_DFACTOR,
+                  NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA);
   }
   pb_end(p);
 }
@@ -41,9 +48,7 @@ void SetCombinerControl(int num_combiners,
                     NV097_SET_COMBINER_CONTROL_MUX_SELECT_MSB);
   }
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_CONTROL, setting);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_CONTROL, setting);
 }
 
 static uint32_t MakeInputCombiner(CombinerSource a_source,
@@ -85,28 +90,16 @@ void SetInputColorCombiner(int combiner,
   uint32_t value = MakeInputCombiner(a_source, a_alpha, a_mapping, b_source, b_alpha,
                                      b_mapping, c_source, c_alpha, c_mapping, d_source,
                                      d_alpha, d_mapping);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_COLOR_ICW + combiner * 4, value);
 }
 
 void ClearInputColorCombiner(int combiner) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, 0);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_COLOR_ICW + combiner * 4, 0);
 }
 
 void ClearInputColorCombiners() {
   auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_COLOR_ICW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
+  p = PushStateN(p, NV097_SET_COMBINER_COLOR_ICW, kZeroCombiners, 8);
   pb_end(p);
 }
 
@@ -126,28 +119,16 @@ void SetInputAlphaCombiner(int combiner,
   uint32_t value = MakeInputCombiner(a_source, a_alpha, a_mapping, b_source, b_alpha,
                                      b_mapping, c_source, c_alpha, c_mapping, d_source,
                                      d_alpha, d_mapping);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, value);
 }
 
 void ClearInputAlphaColorCombiner(int combiner) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, 0);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, 0);
 }
 
 void ClearInputAlphaCombiners() {
   auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_ALPHA_ICW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
+  p = PushStateN(p, NV097_SET_COMBINER_ALPHA_ICW, kZeroCombiners, 8);
   pb_end(p);
 }
 
@@ -192,28 +173,16 @@ void SetOutputColorCombiner(int combiner,
     value |= (1 << 18);
   }
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_COLOR_OCW + combiner * 4, value);
 }
 
 void ClearOutputColorCombiner(int combiner) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, 0);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_COLOR_OCW + combiner * 4, 0);
 }
 
 void ClearOutputColorCombiners() {
   auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_COLOR_OCW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
+  p = PushStateN(p, NV097_SET_COMBINER_COLOR_OCW, kZeroCombiners, 8);
   pb_end(p);
 }
 
@@ -227,28 +196,16 @@ void SetOutputAlphaCombiner(int combiner,
                             CombinerOutOp op) {
   uint32_t value = MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product,
                                       cd_dot_product, sum_or_mux, op);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, value);
 }
 
 void ClearOutputAlphaColorCombiner(int combiner) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, 0);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, 0);
 }
 
 void ClearOutputAlphaCombiners() {
   auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_ALPHA_OCW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
+  p = PushStateN(p, NV097_SET_COMBINER_ALPHA_OCW, kZeroCombiners, 8);
   pb_end(p);
 }
 
@@ -273,9 +230,7 @@ void SetFinalCombiner0(CombinerSource a_source,
                    + (channel(c_source, c_alpha, c_invert) << 8)
                    + channel(d_source, d_alpha, d_invert);
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_SPECULAR_FOG_CW0, value);
 }
 
 void SetFinalCombiner1(CombinerSource e_source,
@@ -312,15 +267,11 @@ void SetFinalCombiner1(CombinerSource e_source,
     value += NV097_SET_COMBINER_SPECULAR_FOG_CW1_SPECULAR_CLAMP;
   }
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW1, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_SPECULAR_FOG_CW1, value);
 }
 
 void SetCombinerFactorC0(int combiner, uint32_t value) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_FACTOR0 + 4 * combiner, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_FACTOR0 + 4 * combiner, value);
 }
 
 void SetCombinerFactorC0(int combiner, float red, float green, float blue, float alpha) {
@@ -329,9 +280,7 @@ void SetCombinerFactorC0(int combiner, float red, float green, float blue, float
 }
 
 void SetCombinerFactorC1(int combiner, uint32_t value) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_FACTOR1 + 4 * combiner, value);
-  pb_end(p);
+  SetState(NV097_SET_COMBINER_FACTOR1 + 4 * combiner, value);
 }
 
 void SetCombinerFactorC1(int combiner, float red, float green, float blue, float alpha) {
@@ -340,9 +289,7 @@ void SetCombinerFactorC1(int combiner, float red, float green, float blue, float
 }
 
 void SetFinalCombinerFactorC0(uint32_t value) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SPECULAR_FOG_FACTOR, value);
-  pb_end(p);
+  SetState(NV097_SET_SPECULAR_FOG_FACTOR, value);
 }
 
 void SetFinalCombinerFactorC0(float red, float green, float blue, float alpha) {
@@ -351,9 +298,7 @@ void SetFinalCombinerFactorC0(float red, float green, float blue, float alpha) {
 }
 
 void SetFinalCombinerFactorC1(uint32_t value) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SPECULAR_FOG_FACTOR + 0x04, value);
-  pb_end(p);
+  SetState(NV097_SET_SPECULAR_FOG_FACTOR + 0x04, value);
 }
 
 void SetFinalCombinerFactorC1(float red, float green, float blue, float alpha) {
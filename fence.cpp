@@ -0,0 +1,102 @@
+#include "fence.h"
+#include <pbkit/pbkit.h>
+#include <windows.h>
+
+#define MAXRAM 0x03FFAFFF
+
+#ifndef NV097_SET_CONTEXT_DMA_SEMAPHORE
+#define NV097_SET_CONTEXT_DMA_SEMAPHORE 0x000001A4
+#endif
+#ifndef NV097_SET_SEMAPHORE_OFFSET
+#define NV097_SET_SEMAPHORE_OFFSET 0x00001D6C
+#endif
+#ifndef NV097_BACK_END_WRITE_SEMAPHORE_RELEASE
+#define NV097_BACK_END_WRITE_SEMAPHORE_RELEASE 0x00001D70
+#endif
+
+namespace PbkitSdlGpu {
+
+// DMA channel ID for the context covering the semaphore. It must not be one pbkit or the
+// application binds, so it can be moved with PBKITSDLGPU_SEMAPHORE_DMA_CHANNEL.
+#ifndef PBKITSDLGPU_SEMAPHORE_DMA_CHANNEL
+#define PBKITSDLGPU_SEMAPHORE_DMA_CHANNEL 25
+#endif
+static constexpr uint32_t kSemaphoreDmaChannel = PBKITSDLGPU_SEMAPHORE_DMA_CHANNEL;
+
+static uint32_t last_inserted_fence = 0;
+static uint32_t last_completed_fence = 0;
+
+// Written by the GPU with the value of each fence once every command before it has finished
+// rendering. Null if the semaphore could not be set up, in which case fences only complete once
+// the GPU goes idle.
+static volatile uint32_t* semaphore = nullptr;
+static struct s_CtxDma semaphore_dma;
+
+// Fence values wrap around, so they are compared by their distance.
+static bool IsAtOrBefore(uint32_t fence, uint32_t other) { return (int32_t)(fence - other) <= 0; }
+
+bool InitFences() {
+  if (!semaphore) {
+    // Uncached, so polling sees the GPU's writes.
+    semaphore = static_cast<volatile uint32_t*>(
+        MmAllocateContiguousMemoryEx(4096, 0, MAXRAM, 0, PAGE_NOCACHE | PAGE_READWRITE));
+    if (!semaphore) {
+      return false;
+    }
+  }
+  *semaphore = last_inserted_fence;
+  last_completed_fence = last_inserted_fence;
+
+  pb_create_dma_ctx(kSemaphoreDmaChannel, DMA_CLASS_3D, 0, MAXRAM, &semaphore_dma);
+  pb_bind_channel(&semaphore_dma);
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_CONTEXT_DMA_SEMAPHORE, semaphore_dma.ChannelID);
+  p = pb_push1(p, NV097_SET_SEMAPHORE_OFFSET, (intptr_t)semaphore & 0x03FFFFFF);
+  pb_end(p);
+  return true;
+}
+
+uint32_t InsertFence() {
+  if (!++last_inserted_fence) {
+    // 0 is reserved for the fence that is always complete.
+    ++last_inserted_fence;
+  }
+
+  if (semaphore) {
+    auto p = pb_begin();
+    p = pb_push1(p, NV097_BACK_END_WRITE_SEMAPHORE_RELEASE, last_inserted_fence);
+    pb_end(p);
+  }
+  return last_inserted_fence;
+}
+
+uint32_t GetCompletedFence() {
+  if (semaphore) {
+    uint32_t value = *semaphore;
+    // The semaphore may lag behind fences that were marked complete when the GPU went idle.
+    if (!IsAtOrBefore(value, last_completed_fence)) {
+      last_completed_fence = value;
+    }
+  } else if (!pb_busy()) {
+    OnGPUIdle();
+  }
+  return last_completed_fence;
+}
+
+bool IsFenceComplete(uint32_t fence) {
+  if (!fence || IsAtOrBefore(fence, last_completed_fence)) {
+    return true;
+  }
+  return IsAtOrBefore(fence, GetCompletedFence());
+}
+
+void WaitForFence(uint32_t fence) {
+  while (!IsFenceComplete(fence)) {
+    /* Wait for completion... */
+  }
+}
+
+void OnGPUIdle() { last_completed_fence = last_inserted_fence; }
+
+}  // namespace PbkitSdlGpu
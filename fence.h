@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PbkitSdlGpu {
+
+// Fences mark a point in the push buffer. A fence is complete once the GPU has processed every
+// command that was pushed before it was inserted.
+//
+// Each fence pushes a semaphore release that makes the GPU write the fence value to memory once
+// rendering has caught up with it, so completion can be polled without draining the push buffer.
+//
+// Fence values increase monotonically, wrapping around after 2^32 fences; 0 is never returned by
+// InsertFence() and is always considered complete.
+
+// Sets up the semaphore the GPU writes completed fences to. Must be called after pb_init. Until it
+// has succeeded, fences only complete once the GPU is idle.
+bool InitFences();
+
+// Returns a fence covering all commands pushed so far.
+uint32_t InsertFence();
+
+// Returns the most recent fence the GPU has passed.
+uint32_t GetCompletedFence();
+
+// Returns true if the GPU has passed `fence`.
+bool IsFenceComplete(uint32_t fence);
+
+// Blocks until the GPU has passed `fence`.
+void WaitForFence(uint32_t fence);
+
+// Marks every fence inserted so far as complete. Must only be called while the GPU is idle.
+void OnGPUIdle();
+
+}  // namespace PbkitSdlGpu
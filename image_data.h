@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include "SDL_gpu.h"
+
+struct PBKitSDLGPUPalette;
+
+namespace PbkitSdlGpu {
+
+struct ManagedImage;
+
+struct UVRect {
+  float left, top, right, bottom;
+};
+
+// Maps the normalized image coordinates accepted by GPU_PrimitiveBatchV onto a texture.
+struct TexCoordMapping {
+  float scale_u, scale_v;
+  float offset_u, offset_v;
+};
+
+// Renderer data attached to every GPU_Image created by the pbkit renderer.
+struct PBKitImageData {
+  // Texture memory, owned by the texture heap which may move it. Only kept up to date on the image
+  // that allocated it; use TextureData() to access it through an alias.
+  uint8_t* data;
+  int format;
+  uint32_t pitch;
+  uint32_t byte_length;
+  int size_u;
+  int size_v;
+  int mip_levels;
+  // Linear (LU_IMAGE) textures are stored row by row at `pitch` and are addressed with texel
+  // coordinates rather than normalized ones.
+  bool linear;
+  // Updates of 16 bit textures are dithered rather than rounded.
+  bool dither;
+  // Palette sampled by I8 textures, null for every other format. Each image holds a reference.
+  PBKitSDLGPUPalette* palette;
+
+  // Alias images get their own copy of the owner's data so they may address a sub-rectangle of it.
+  // `owner` is null for the image that allocated the texture memory, which is released once
+  // `refcount` drops to zero.
+  PBKitImageData* owner;
+  int refcount;
+
+  // Residency of the texture, null unless the owner has a restore source. While evicted, `data` is
+  // null.
+  ManagedImage* managed;
+
+  // Copy of the owner's texels in cached memory, which queued updates build their shadow texture
+  // from instead of reading back texture memory. Null unless queued updates have used it, and
+  // dropped by anything else that writes to the texture.
+  uint8_t* cached_texels;
+
+  // Texel position of the image within the texture, non-zero for atlas sub-images.
+  int offset_x;
+  int offset_y;
+
+  uint8_t* TextureData() const { return owner ? owner->data : data; }
+
+  void DropCachedTexels() {
+    SDL_free(cached_texels);
+    cached_texels = nullptr;
+  }
+
+  UVRect MakeTexCoords(GPU_Rect* src_rect, GPU_Image* image) const {
+    float pixel_left = src_rect->x + (float)offset_x;
+    float pixel_top = src_rect->y + (float)offset_y;
+    float pixel_right = pixel_left + src_rect->w;
+    float pixel_bottom = pixel_top + src_rect->h;
+
+    if (linear) {
+      return { pixel_left, pixel_top, pixel_right, pixel_bottom };
+    }
+
+    UVRect ret{ pixel_left / (float)image->texture_w, pixel_top / (float)image->texture_h,
+                pixel_right / (float)image->texture_w,
+                pixel_bottom / (float)image->texture_h };
+    return std::move(ret);
+  }
+
+  TexCoordMapping MakeTexCoordMapping(const GPU_Image* image) const {
+    if (linear) {
+      return { (float)image->w, (float)image->h, (float)offset_x, (float)offset_y };
+    }
+
+    float texture_w = (float)image->texture_w;
+    float texture_h = (float)image->texture_h;
+    return { (float)image->w / texture_w, (float)image->h / texture_h,
+             (float)offset_x / texture_w, (float)offset_y / texture_h };
+  }
+};
+
+}  // namespace PbkitSdlGpu
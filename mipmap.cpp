@@ -0,0 +1,104 @@
+#include "mipmap.h"
+
+#include <cstring>
+
+#include "debug_output.h"
+
+namespace PbkitSdlGpu {
+
+// Bit fields of the channels of a 16 bit texel.
+struct ChannelField {
+  uint32_t shift;
+  uint32_t mask;
+};
+
+static constexpr ChannelField kR5G6B5Fields[] = { { 0, 0x1F }, { 5, 0x3F }, { 11, 0x1F } };
+static constexpr ChannelField kA1R5G5B5Fields[] = { { 0, 0x1F }, { 5, 0x1F }, { 10, 0x1F }, { 15, 0x1 } };
+static constexpr ChannelField kA4R4G4B4Fields[] = { { 0, 0xF }, { 4, 0xF }, { 8, 0xF }, { 12, 0xF } };
+
+uint32_t MipChainSize(uint32_t width, uint32_t height, uint32_t levels, uint32_t bytes_per_pixel) {
+  uint32_t ret = 0;
+  for (uint32_t level = 0; level < levels; ++level) {
+    ret += width * height * bytes_per_pixel;
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+  return ret;
+}
+
+// Returns the rounded average of each byte of four 32 bit texels. The two low bits of every channel
+// are summed separately so that all four channels are averaged at once without carries crossing
+// between them.
+static inline uint32_t Average32(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  uint32_t high = ((a >> 2) & 0x3F3F3F3F) + ((b >> 2) & 0x3F3F3F3F) + ((c >> 2) & 0x3F3F3F3F)
+                  + ((d >> 2) & 0x3F3F3F3F);
+  uint32_t low = (a & 0x03030303) + (b & 0x03030303) + (c & 0x03030303) + (d & 0x03030303);
+  return high + (((low + 0x02020202) >> 2) & 0x03030303);
+}
+
+template <size_t N>
+static inline uint16_t Average16(const ChannelField (&fields)[N], uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  uint32_t ret = 0;
+  for (const auto& field : fields) {
+    uint32_t sum = ((a >> field.shift) & field.mask) + ((b >> field.shift) & field.mask)
+                   + ((c >> field.shift) & field.mask) + ((d >> field.shift) & field.mask);
+    ret |= ((sum + 2) >> 2) << field.shift;
+  }
+  return (uint16_t)ret;
+}
+
+// Box filters `count` groups of `group` texels at `src` into one texel each at `dst`. Groups of two
+// are averaged as if each texel appeared twice.
+template <typename T, typename Average>
+static void DownsampleLevel(const uint8_t* src, uint8_t* dst, uint32_t count, uint32_t group, Average average) {
+  auto in = reinterpret_cast<const T*>(src);
+  auto out = reinterpret_cast<T*>(dst);
+  if (group == 4) {
+    for (uint32_t i = 0; i < count; ++i, in += 4) {
+      out[i] = average(in[0], in[1], in[2], in[3]);
+    }
+  } else {
+    for (uint32_t i = 0; i < count; ++i, in += 2) {
+      out[i] = average(in[0], in[1], in[0], in[1]);
+    }
+  }
+}
+
+void DownsampleMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels, TexelPacking packing) {
+  PBKITSDLGPU_ASSERT(packing != TexelPacking::kI8);
+  uint32_t bytes_per_pixel = texel_size(packing);
+
+  uint8_t* src = chain;
+  for (uint32_t level = 1; level < levels; ++level) {
+    uint8_t* dst = src + width * height * bytes_per_pixel;
+    uint32_t group = (width > 1 ? 2 : 1) * (height > 1 ? 2 : 1);
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+    uint32_t count = width * height;
+
+    switch (packing) {
+    case TexelPacking::kR5G6B5:
+      DownsampleLevel<uint16_t>(src, dst, count, group, [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        return Average16(kR5G6B5Fields, a, b, c, d);
+      });
+      break;
+    case TexelPacking::kA1R5G5B5:
+      DownsampleLevel<uint16_t>(src, dst, count, group, [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        return Average16(kA1R5G5B5Fields, a, b, c, d);
+      });
+      break;
+    case TexelPacking::kA4R4G4B4:
+      DownsampleLevel<uint16_t>(src, dst, count, group, [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        return Average16(kA4R4G4B4Fields, a, b, c, d);
+      });
+      break;
+    default:
+      DownsampleLevel<uint32_t>(src, dst, count, group, Average32);
+      break;
+    }
+
+    src = dst;
+  }
+}
+
+}  // namespace PbkitSdlGpu
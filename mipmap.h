@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "third_party/swizzle.h"
+
+namespace PbkitSdlGpu {
+
+// Returns the number of bytes taken by the first `levels` levels of a `width` x `height` texture
+// with `bytes_per_pixel` bytes per texel. Levels are stored back to back, largest first.
+uint32_t MipChainSize(uint32_t width, uint32_t height, uint32_t levels, uint32_t bytes_per_pixel);
+
+// Fills levels 1 to `levels` - 1 of the swizzled mip chain at `chain` by box filtering level 0.
+// `width` and `height` are the power of two dimensions of level 0 and `packing` its texel layout;
+// paletted textures cannot be filtered.
+//
+// The 2x2 block of texels that a texel of the next level covers is always contiguous in swizzled
+// order, and the blocks are in the swizzled order of the next level, so each level is produced by a
+// single linear pass over the previous one.
+void DownsampleMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels, TexelPacking packing);
+
+}  // namespace PbkitSdlGpu
@@ -0,0 +1,74 @@
+#include "palette.h"
+
+#include <cstring>
+
+#include "SDL_gpu.h"
+#include "debug_output.h"
+#include "texture_heap.h"
+
+namespace PbkitSdlGpu {
+
+static constexpr uint32_t kPaletteSize = sizeof(Palette::entries);
+
+static uint32_t PackEntry(const SDL_Color& color) {
+  return ((uint32_t)color.a << 24) | ((uint32_t)color.r << 16) | ((uint32_t)color.g << 8) | color.b;
+}
+
+Palette* CreatePalette(const SDL_Color* colors, uint32_t count) {
+  auto palette = (Palette*)SDL_malloc(sizeof(Palette));
+  if (!palette) {
+    GPU_PushErrorCode("PBKitSDLGPUCreatePalette", GPU_ERROR_BACKEND_ERROR,
+                      "Failed to allocate palette");
+    return nullptr;
+  }
+  if (!AllocateTextureMemory(kPaletteSize, &palette->data)) {
+    GPU_PushErrorCode("PBKitSDLGPUCreatePalette", GPU_ERROR_BACKEND_ERROR,
+                      "Failed to allocate texture memory");
+    SDL_free(palette);
+    return nullptr;
+  }
+
+  palette->refcount = 1;
+  memset(palette->entries, 0, kPaletteSize);
+  count = count < 256 ? count : 256;
+  for (uint32_t i = 0; i < count; ++i) {
+    palette->entries[i] = PackEntry(colors[i]);
+  }
+  memcpy(palette->data, palette->entries, kPaletteSize);
+  return palette;
+}
+
+void RetainPalette(Palette* palette) { ++palette->refcount; }
+
+void ReleasePalette(Palette* palette) {
+  if (--palette->refcount) {
+    return;
+  }
+
+  FreeTextureMemory(palette->data);
+  SDL_free(palette);
+}
+
+void SetPaletteColors(Palette* palette, const SDL_Color* colors, uint32_t first, uint32_t count) {
+  if (first >= 256 || !count) {
+    return;
+  }
+  count = count < 256 - first ? count : 256 - first;
+  for (uint32_t i = 0; i < count; ++i) {
+    palette->entries[first + i] = PackEntry(colors[i]);
+  }
+
+  // The old memory is retired until the GPU has passed every draw that may sample it. Allocation
+  // cannot fail since, at worst, waiting for the GPU frees the block that was just retired.
+  FreeTextureMemory(palette->data);
+  AllocateTextureMemory(kPaletteSize, &palette->data);
+  PBKITSDLGPU_ASSERT(palette->data);
+  memcpy(palette->data, palette->entries, kPaletteSize);
+}
+
+uint32_t GetPaletteRegisterValue(const Palette* palette) {
+  // The offset is 64 byte aligned; the low bits select DMA context A and a length of 256 entries.
+  return (intptr_t)palette->data & 0x03FFFFC0;
+}
+
+}  // namespace PbkitSdlGpu
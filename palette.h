@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SDL.h"
+
+#ifndef NV097_SET_TEXTURE_PALETTE
+#define NV097_SET_TEXTURE_PALETTE 0x00001B20
+#endif
+
+// A 256 entry A8R8G8B8 palette in texture memory that any number of I8 images may sample from. It
+// is the type behind the opaque PBKitSDLGPUPalette handle.
+struct PBKitSDLGPUPalette {
+  // Texture memory, owned by the texture heap which may move it.
+  uint8_t* data;
+  // Copy of the entries in cached memory, so updates never read back from texture memory.
+  uint32_t entries[256];
+  int refcount;
+};
+
+namespace PbkitSdlGpu {
+
+using Palette = PBKitSDLGPUPalette;
+
+// Creates a palette whose first `count` entries are `colors` and whose remaining entries are
+// transparent black. The palette starts with a single reference.
+Palette* CreatePalette(const SDL_Color* colors, uint32_t count);
+
+void RetainPalette(Palette* palette);
+
+// Drops a reference, freeing the palette once none are left.
+void ReleasePalette(Palette* palette);
+
+// Replaces entries `first` to `first` + `count` - 1. The palette moves to new texture memory so that
+// draws that were already pushed keep their colors, and images pick up the change with a single
+// register write when they are next bound.
+void SetPaletteColors(Palette* palette, const SDL_Color* colors, uint32_t first, uint32_t count);
+
+// Returns the NV097_SET_TEXTURE_PALETTE value that selects `palette`.
+uint32_t GetPaletteRegisterValue(const Palette* palette);
+
+}  // namespace PbkitSdlGpu
@@ -2,15 +2,27 @@
 #include <hal/debug.h>
 #include <pbkit/nv_regs.h>
 #include <pbkit/pbkit.h>
+#include <xmmintrin.h>
+#include <utility>
+#include <vector>
 #include "third_party/swizzle.h"
 #include "third_party/math3d.h"
 #include "SDL_gpu.h"
 #include "SDL_gpu_RendererImpl.h"
+#include "atlas.h"
 #include "color_combiner.h"
 #include "debug_output.h"
+#include "fence.h"
+#include "image_data.h"
+#include "mipmap.h"
+#include "palette.h"
 #include "precalculated_vertex_shader.h"
+#include "register_cache.h"
+#include "residency.h"
+#include "texture_container.h"
+#include "texture_heap.h"
+#include "vertex_ring_buffer.h"
 
-#define MAXRAM 0x03FFAFFF
 #define MASK(mask, val) (((val) << (__builtin_ffs(mask) - 1)) & (mask))
 
 #define NV097_SET_COLOR_MATERIAL_ALL_FROM_MATERIAL 0
@@ -31,43 +43,87 @@
 // NV_PGRAPH_TEXFILTER0_CONVOLUTION_KERNEL from xemu.
 #define NV097_SET_TEXTURE_FILTER_CONVOLUTION_KERNEL 0x0000E000
 
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8B8G8R8
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8B8G8R8 0x3F
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R8G8B8A8 0x41
+#endif
+
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8
+#define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8 0x06
+#endif
+
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8 0x12
+#endif
+
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8
+#define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8 0x0B
+#endif
+
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5
+#define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A1R5G5B5 0x02
+#define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A4R4G4B4 0x04
+#define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5 0x05
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A1R5G5B5 0x10
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R5G6B5 0x11
+#define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A4R4G4B4 0x1D
+#endif
+
+#ifndef NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5
+#define NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5 0x0C
+#define NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT23_A8R8G8B8 0x0E
+#define NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT45_A8R8G8B8 0x0F
+#endif
+
+#ifndef NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE 0x0000000F
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F 2
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_OGL 4
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_SIZE 0x000000F0
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_STRIDE 0xFFFFFF00
+#endif
+
+#ifndef NV097_DRAW_ARRAYS_COUNT
+#define NV097_DRAW_ARRAYS_COUNT 0xFF000000
+#define NV097_DRAW_ARRAYS_START_INDEX 0x00FFFFFF
+#endif
+
+#ifndef NV097_SET_SURFACE_FORMAT_COLOR_LE_R5G6B5
+#define NV097_SET_SURFACE_FORMAT_COLOR_LE_R5G6B5 0x03
+#endif
+
+#ifndef NV097_SET_CONTEXT_DMA_COLOR
+#define NV097_SET_CONTEXT_DMA_COLOR 0x00000194
+#endif
+
+#ifndef NV097_WAIT_FOR_IDLE
+#define NV097_WAIT_FOR_IDLE 0x00000110
+#endif
+
+#define MAXRAM 0x03FFAFFF
+
+// Methods sent with this flag write every parameter to the same method rather than advancing.
+#define NV2A_SUPPRESS_COMMAND_INCREMENT(method) (0x40000000 | (method))
+
 namespace PbkitSdlGpu {
 
 static constexpr GPU_RendererEnum GPU_RENDERER_PBKIT = GPU_RENDERER_CUSTOM_0 + 10;
 static GPU_RendererID renderer_id;
 
 struct PBKitSDLContext {
-  PBKitSDLContext(GPU_Target* target, DWORD width, DWORD height) : target(target), width(width), height(height) {}
+  PBKitSDLContext(GPU_Target* target, DWORD width, DWORD height, Uint16 window_w, Uint16 window_h)
+      : target(target), width(width), height(height), window_w(window_w), window_h(window_h) {}
 
   GPU_Target* target;
   DWORD width;
   DWORD height;
+  // Draws to the back buffer are clipped to the size requested from GPU_Init.
+  Uint16 window_w;
+  Uint16 window_h;
 };
 
-struct UVRect {
-  float left, top, right, bottom;
-};
-
-struct PBKitImageData {
-  uint8_t* data;
-  int format;
-  uint32_t pitch;
-  uint32_t byte_length;
-  int size_u;
-  int size_v;
-
-  UVRect MakeTexCoords(GPU_Rect* src_rect, GPU_Image* image) const {
-    float pixel_left = src_rect->x;
-    float pixel_top = src_rect->y;
-    float pixel_right = pixel_left + src_rect->w;
-    float pixel_bottom = pixel_top + src_rect->h;
-
-    UVRect ret{ pixel_left / (float)image->texture_w, pixel_top / (float)image->texture_h,
-                pixel_right / (float)image->texture_w,
-                pixel_bottom / (float)image->texture_h };
-    return std::move(ret);
-  }
-};
+// Large enough for a full PrimitiveBatchV of 65535 vertices with every attribute.
+static constexpr uint32_t kVertexRingBufferSize = 2 * 1024 * 1024;
 
 #define NV2A_VERTEX_ATTR_POSITION 0
 #define NV2A_VERTEX_ATTR_WEIGHT 1
@@ -219,6 +275,115 @@ static uint32_t* pb_push_4x3_matrix(uint32_t* p, DWORD command, const float* m)
   return p;
 }
 
+// Images become render targets by pointing the color surface at their texture memory, in the
+// same swizzled or pitch layout they are sampled in. Draws bind the surface of their target before
+// they are pushed, so switching only costs anything when the target changes.
+
+// pbkit renders into the back buffer through its DMA context on channel 9, which
+// pb_target_back_buffer rebases onto the current framebuffer so that surface offsets are relative
+// to it. That context cannot reach textures, so image targets switch the color surface to a context
+// of their own and binding the back buffer switches it back.
+static constexpr uint32_t kBackBufferDmaChannel = 9;
+// DMA channel ID for the context covering all of memory, so the color surface can be placed on any
+// texture. Like the fence semaphore's, it can be moved if pbkit or the application binds it.
+#ifndef PBKITSDLGPU_RENDER_TARGET_DMA_CHANNEL
+#define PBKITSDLGPU_RENDER_TARGET_DMA_CHANNEL 26
+#endif
+static constexpr uint32_t kRenderTargetDmaChannel = PBKITSDLGPU_RENDER_TARGET_DMA_CHANNEL;
+static struct s_CtxDma render_target_dma;
+
+// The image whose texture the color surface points at, or null for the back buffer.
+static GPU_Image* bound_target_image = nullptr;
+
+// Returns the NV097_SET_SURFACE_FORMAT_COLOR that writes texels of `texture_format`, or 0 if the
+// GPU cannot render into it.
+static uint32_t GetSurfaceColorFormat(int texture_format) {
+  switch (texture_format) {
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8:
+    return NV097_SET_SURFACE_FORMAT_COLOR_LE_A8R8G8B8;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R5G6B5:
+    return NV097_SET_SURFACE_FORMAT_COLOR_LE_R5G6B5;
+  default:
+    return 0;
+  }
+}
+
+static PBKitSDLContext* GetWindowContext(GPU_Renderer* renderer) {
+  return static_cast<PBKitSDLContext*>(renderer->current_context_target->context->data);
+}
+
+static void BindBackBuffer(const PBKitSDLContext* context) {
+  if (!bound_target_image) {
+    return;
+  }
+
+  auto p = pb_begin();
+  // Rendering into the texture has to finish before later draws sample it.
+  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, kBackBufferDmaChannel);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, context->window_w << 16);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_VERTICAL, context->window_h << 16);
+  pb_end(p);
+
+  pb_target_back_buffer();
+  // pb_target_back_buffer writes the surface clip, format, pitch and offsets directly.
+  InvalidateState(NV097_SET_SURFACE_CLIP_HORIZONTAL, 6);
+  bound_target_image = nullptr;
+}
+
+// Points the color surface at `target`. The surface of an image target is pushed through the
+// register cache every time, since its texture may have moved since it was last bound.
+static void BindTarget(GPU_Target* target) {
+  auto image = target->image;
+  if (!image) {
+    // Targets whose image has been freed draw to the screen.
+    BindBackBuffer(target->context ? static_cast<PBKitSDLContext*>(target->context->data)
+                                   : GetWindowContext(target->renderer));
+    return;
+  }
+
+  if (!MakeImageResident(image)) {
+    // Draws go to the screen rather than to memory that is no longer the texture's.
+    BindBackBuffer(GetWindowContext(image->renderer));
+    return;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  uint32_t format =
+      MASK(NV097_SET_SURFACE_FORMAT_COLOR, GetSurfaceColorFormat(image_data->format))
+      | MASK(NV097_SET_SURFACE_FORMAT_ZETA, NV097_SET_SURFACE_FORMAT_ZETA_Z16)
+      | MASK(NV097_SET_SURFACE_FORMAT_ANTI_ALIASING,
+             NV097_SET_SURFACE_FORMAT_ANTI_ALIASING_CENTER_1);
+  if (image_data->linear) {
+    format |= MASK(NV097_SET_SURFACE_FORMAT_TYPE, NV097_SET_SURFACE_FORMAT_TYPE_PITCH);
+  } else {
+    format |= MASK(NV097_SET_SURFACE_FORMAT_TYPE, NV097_SET_SURFACE_FORMAT_TYPE_SWIZZLE)
+              | MASK(NV097_SET_SURFACE_FORMAT_WIDTH, image_data->size_u)
+              | MASK(NV097_SET_SURFACE_FORMAT_HEIGHT, image_data->size_v);
+  }
+
+  auto p = pb_begin();
+  if (bound_target_image != image) {
+    // Draws already pushed may still be sampling the texture, or rendering into the previous one.
+    p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+    if (!bound_target_image) {
+      p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, render_target_dma.ChannelID);
+    }
+  }
+  p = PushState(p, NV097_SET_SURFACE_CLIP_HORIZONTAL, image->w << 16);
+  p = PushState(p, NV097_SET_SURFACE_CLIP_VERTICAL, image->h << 16);
+  p = PushState(p, NV097_SET_SURFACE_FORMAT, format);
+  // Depth testing is never enabled, so the zeta surface is not accessed.
+  p = PushState(p, NV097_SET_SURFACE_PITCH, image_data->pitch | (image_data->pitch << 16));
+  p = PushState(p, NV097_SET_SURFACE_COLOR_OFFSET, (intptr_t)image_data->data & 0x03FFFFFF);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, image->w << 16);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_VERTICAL, image->h << 16);
+  pb_end(p);
+  bound_target_image = image;
+}
+
 static GPU_Target* SDLCALL Init(GPU_Renderer* renderer,
                                 GPU_RendererID renderer_request,
                                 Uint16 w,
@@ -242,8 +407,10 @@ static GPU_Target* SDLCALL Init(GPU_Renderer* renderer,
   target->context = (GPU_Context*)SDL_malloc(sizeof(GPU_Context));
   memset(target->context, 0, sizeof(GPU_Context));
   target->context->refcount = 1;
+  target->context->shapes_use_blending = GPU_TRUE;
+  target->context->shapes_blend_mode = GPU_GetBlendModeFromPreset(GPU_BLEND_NORMAL);
 
-  auto data = new PBKitSDLContext(target, pb_back_buffer_width(), pb_back_buffer_height());
+  auto data = new PBKitSDLContext(target, pb_back_buffer_width(), pb_back_buffer_height(), w, h);
 
   target->context->data = data;
   target->context->context = nullptr;
@@ -255,67 +422,83 @@ static GPU_Target* SDLCALL Init(GPU_Renderer* renderer,
              NV097_SET_SURFACE_FORMAT_ANTI_ALIASING_CENTER_1)
       | MASK(NV097_SET_SURFACE_FORMAT_TYPE, NV097_SET_SURFACE_FORMAT_TYPE_PITCH);
 
+  // pb_init leaves the hardware in an unknown state.
+  InvalidateAllState();
+
+  if (!InitFences()) {
+    debugPrint("Failed to allocate fence semaphore, fences will wait for the GPU to go idle.\n");
+  }
+
+  if (!InitVertexRingBuffer(kVertexRingBufferSize)) {
+    debugPrint("Failed to allocate vertex ring buffer, falling back to inline vertices.\n");
+  }
+
+  pb_create_dma_ctx(kRenderTargetDmaChannel, DMA_CLASS_3D, 0, MAXRAM, &render_target_dma);
+  pb_bind_channel(&render_target_dma);
+  bound_target_image = nullptr;
+
   auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_FORMAT, value);
-  p = pb_push1(p, NV097_SET_SURFACE_CLIP_HORIZONTAL, (data->width << 16));
-  p = pb_push1(p, NV097_SET_SURFACE_CLIP_VERTICAL, (data->height << 16));
-
-  p = pb_push1(p, NV097_SET_LIGHTING_ENABLE, false);
-  p = pb_push1(p, NV097_SET_SPECULAR_ENABLE, false);
-  p = pb_push1(p, NV097_SET_LIGHT_CONTROL, 0x20001);
-  p = pb_push1(p, NV097_SET_LIGHT_ENABLE_MASK, NV097_SET_LIGHT_ENABLE_MASK_LIGHT0_OFF);
-  p = pb_push1(p, NV097_SET_COLOR_MATERIAL, NV097_SET_COLOR_MATERIAL_ALL_FROM_MATERIAL);
-  p = pb_push1f(p, NV097_SET_MATERIAL_ALPHA, 1.0f);
-
-  p = pb_push1(p, NV097_SET_BLEND_ENABLE, true);
-  p = pb_push1(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
-  p = pb_push1(p, NV097_SET_BLEND_FUNC_SFACTOR, NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA);
-  p = pb_push1(p, NV097_SET_BLEND_FUNC_DFACTOR,
-               NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA);
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_LIGHT_MODEL_TWO_SIDE_ENABLE, 0);
-  p = pb_push1(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
-  p = pb_push1(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_SURFACE_FORMAT, value);
+  p = PushState(p, NV097_SET_SURFACE_CLIP_HORIZONTAL, (data->width << 16));
+  p = PushState(p, NV097_SET_SURFACE_CLIP_VERTICAL, (data->height << 16));
+
+  p = PushState(p, NV097_SET_LIGHTING_ENABLE, false);
+  p = PushState(p, NV097_SET_SPECULAR_ENABLE, false);
+  p = PushState(p, NV097_SET_LIGHT_CONTROL, 0x20001);
+  p = PushState(p, NV097_SET_LIGHT_ENABLE_MASK, NV097_SET_LIGHT_ENABLE_MASK_LIGHT0_OFF);
+  p = PushState(p, NV097_SET_COLOR_MATERIAL, NV097_SET_COLOR_MATERIAL_ALL_FROM_MATERIAL);
+  p = PushStatef(p, NV097_SET_MATERIAL_ALPHA, 1.0f);
+
+  p = PushState(p, NV097_SET_BLEND_ENABLE, true);
+  p = PushState(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
+  p = PushState(p, NV097_SET_BLEND_FUNC_SFACTOR, NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA);
+  p = PushState(p, NV097_SET_BLEND_FUNC_DFACTOR,
+                NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_LIGHT_MODEL_TWO_SIDE_ENABLE, 0);
+  p = PushState(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
 
   p = pb_push1(p, NV097_SET_VERTEX_DATA4UB + 0x10, 0); // Specular
   p = pb_push1(p, NV097_SET_VERTEX_DATA4UB + 0x1C, 0xFFFFFFFF); // Back diffuse
   p = pb_push1(p, NV097_SET_VERTEX_DATA4UB + 0x20, 0); // Back specular
 
-  p = pb_push1(p, NV097_SET_POINT_PARAMS_ENABLE, false);
-  p = pb_push1(p, NV097_SET_POINT_SMOOTH_ENABLE, false);
-  p = pb_push1(p, NV097_SET_POINT_SIZE, 8);
+  p = PushState(p, NV097_SET_POINT_PARAMS_ENABLE, false);
+  p = PushState(p, NV097_SET_POINT_SMOOTH_ENABLE, false);
+  p = PushState(p, NV097_SET_POINT_SIZE, 8);
 
-  p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
-  p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, 0x0);
+  p = PushState(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
+  p = PushState(p, NV097_SET_SHADER_STAGE_PROGRAM, 0x0);
 
-  p = pb_push1(p, NV097_SET_FOG_ENABLE, false);
-  p = pb_push4(p, NV097_SET_TEXTURE_MATRIX_ENABLE, 0, 0, 0, 0);
-  p = pb_push1(p, NV097_SET_TEXTURE_BORDER_COLOR, 0xFFFFFFFF);
+  p = PushState(p, NV097_SET_FOG_ENABLE, false);
+  static constexpr uint32_t kTextureMatrixDisabled[4] = { 0, 0, 0, 0 };
+  p = PushStateN(p, NV097_SET_TEXTURE_MATRIX_ENABLE, kTextureMatrixDisabled, 4);
+  p = PushState(p, NV097_SET_TEXTURE_BORDER_COLOR, 0xFFFFFFFF);
 
-  p = pb_push1(p, NV097_SET_FRONT_FACE, NV097_SET_FRONT_FACE_V_CW);
-  p = pb_push1(p, NV097_SET_CULL_FACE, NV097_SET_CULL_FACE_V_BACK);
-  p = pb_push1(p, NV097_SET_CULL_FACE_ENABLE, true);
+  p = PushState(p, NV097_SET_FRONT_FACE, NV097_SET_FRONT_FACE_V_CW);
+  p = PushState(p, NV097_SET_CULL_FACE, NV097_SET_CULL_FACE_V_BACK);
+  p = PushState(p, NV097_SET_CULL_FACE_ENABLE, true);
 
-  p = pb_push1(p, NV097_SET_DEPTH_MASK, true);
-  p = pb_push1(p, NV097_SET_DEPTH_FUNC, NV097_SET_DEPTH_FUNC_V_LESS);
-  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
-  p = pb_push1(p, NV097_SET_STENCIL_TEST_ENABLE, false);
-  p = pb_push1(p, NV097_SET_STENCIL_MASK, true);
+  p = PushState(p, NV097_SET_DEPTH_MASK, true);
+  p = PushState(p, NV097_SET_DEPTH_FUNC, NV097_SET_DEPTH_FUNC_V_LESS);
+  p = PushState(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+  p = PushState(p, NV097_SET_STENCIL_TEST_ENABLE, false);
+  p = PushState(p, NV097_SET_STENCIL_MASK, true);
 
-  p = pb_push1(p, NV097_SET_NORMALIZATION_ENABLE, false);
+  p = PushState(p, NV097_SET_NORMALIZATION_ENABLE, false);
 
-  p = pb_push1(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, w << 16);
-  p = pb_push1(p, NV097_SET_WINDOW_CLIP_VERTICAL, h << 16);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, data->window_w << 16);
+  p = PushState(p, NV097_SET_WINDOW_CLIP_VERTICAL, data->window_h << 16);
 
-  p = pb_push1(p, NV097_SET_TEXGEN_S, NV097_SET_TEXGEN_S_DISABLE);
-  p = pb_push1(p, NV097_SET_TEXGEN_T, NV097_SET_TEXGEN_S_DISABLE);
-  p = pb_push1(p, NV097_SET_TEXGEN_R, NV097_SET_TEXGEN_S_DISABLE);
-  p = pb_push1(p, NV097_SET_TEXGEN_Q, NV097_SET_TEXGEN_S_DISABLE);
+  p = PushState(p, NV097_SET_TEXGEN_S, NV097_SET_TEXGEN_S_DISABLE);
+  p = PushState(p, NV097_SET_TEXGEN_T, NV097_SET_TEXGEN_S_DISABLE);
+  p = PushState(p, NV097_SET_TEXGEN_R, NV097_SET_TEXGEN_S_DISABLE);
+  p = PushState(p, NV097_SET_TEXGEN_Q, NV097_SET_TEXGEN_S_DISABLE);
 
   p = pb_push4f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT, 0.0f, 0.0f, 0.0f, 0.0f);
-  p = pb_push1f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, 0.0f);
-  p = pb_push1f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, 0.0f);
+  p = PushStatef(p, NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, 0.0f);
+  p = PushStatef(p, NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, 0.0f);
 
-  p = pb_push1(p, NV097_SET_COMBINER_CONTROL, 1);
+  p = PushState(p, NV097_SET_COMBINER_CONTROL, 1);
 
   pb_end(p);
 
@@ -349,8 +532,14 @@ static GPU_Target* SDLCALL CreateTargetFromWindow(GPU_Renderer* renderer,
 }
 
 static GPU_bool SDLCALL SetActiveTarget(GPU_Renderer* renderer, GPU_Target* target) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return false;
+  if (target == nullptr) {
+    GPU_PushErrorCode("GPU_SetActiveTarget", GPU_ERROR_NULL_ARGUMENT, "target");
+    return GPU_FALSE;
+  }
+
+  renderer->impl->FlushBlitBuffer(renderer);
+  BindTarget(target);
+  return GPU_TRUE;
 }
 
 static void SDLCALL MakeCurrent(GPU_Renderer* renderer,
@@ -424,10 +613,33 @@ static GPU_Camera SDLCALL SetCamera(GPU_Renderer* renderer,
   return {};
 }
 
+// Returns the packing of texels of the NV097 `texture_format`.
+static TexelPacking GetTexelPacking(int texture_format) {
+  switch (texture_format) {
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R5G6B5:
+    return TexelPacking::kR5G6B5;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A1R5G5B5:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A1R5G5B5:
+    return TexelPacking::kA1R5G5B5;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A4R4G4B4:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A4R4G4B4:
+    return TexelPacking::kA4R4G4B4;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8:
+    return TexelPacking::kI8;
+  default:
+    return TexelPacking::k8888;
+  }
+}
+
+// Creates an image without texture memory. The texture format is chosen from `format` unless
+// `texture_format` is given, in which case `format` only describes the data accepted by
+// GPU_UpdateImageBytes.
 static GPU_Image* CreateUninitializedImage(GPU_Renderer* renderer,
                                            Uint16 w,
                                            Uint16 h,
-                                           GPU_FormatEnum format) {
+                                           GPU_FormatEnum format,
+                                           int texture_format = 0) {
   int bytes_per_pixel = 0;
   int pbkit_format;
   SDL_Color white = { 255, 255, 255, 255 };
@@ -451,11 +663,20 @@ static GPU_Image* CreateUninitializedImage(GPU_Renderer* renderer,
     break;
 
   default:
+    // Formats SDL_gpu has no texture format for are only used to describe an explicit one.
+    if (texture_format) {
+      break;
+    }
     GPU_PushErrorCode("GPU_CreateUninitializedImage", GPU_ERROR_DATA_ERROR,
                       "Unsupported image format (0x%x)", format);
     return nullptr;
   }
 
+  if (texture_format) {
+    pbkit_format = texture_format;
+    bytes_per_pixel = texel_size(GetTexelPacking(texture_format));
+  }
+
   if (bytes_per_pixel < 1 || bytes_per_pixel > 4) {
     GPU_PushErrorCode("GPU_CreateUninitializedImage", GPU_ERROR_DATA_ERROR,
                       "Unsupported number of bytes per pixel (%d)", bytes_per_pixel);
@@ -488,6 +709,14 @@ static GPU_Image* CreateUninitializedImage(GPU_Renderer* renderer,
   result->data = data;
   result->is_alias = GPU_FALSE;
   data->format = pbkit_format;
+  data->dither = false;
+  data->palette = nullptr;
+  data->owner = nullptr;
+  data->refcount = 1;
+  data->managed = nullptr;
+  data->cached_texels = nullptr;
+  data->offset_x = 0;
+  data->offset_y = 0;
 
   result->using_virtual_resolution = GPU_FALSE;
   result->w = w;
@@ -501,6 +730,113 @@ static GPU_Image* CreateUninitializedImage(GPU_Renderer* renderer,
   return result;
 }
 
+static bool IsCompressedFormat(uint32_t format) {
+  return format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5
+         || format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT23_A8R8G8B8
+         || format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT45_A8R8G8B8;
+}
+
+// Returns the size of a 2^`size_u` x 2^`size_v` level of compressed `format`. Levels smaller than a
+// block still occupy a whole block.
+static uint32_t CompressedLevelSize(uint32_t format, uint32_t size_u, uint32_t size_v) {
+  uint32_t blocks_x = size_u > 2 ? 1 << (size_u - 2) : 1;
+  uint32_t blocks_y = size_v > 2 ? 1 << (size_v - 2) : 1;
+  uint32_t block_size = format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5 ? 8 : 16;
+  return blocks_x * blocks_y * block_size;
+}
+
+// Returns the size of the first `mip_levels` levels of a compressed texture.
+static uint32_t CompressedImageSize(uint32_t format,
+                                    uint32_t size_u,
+                                    uint32_t size_v,
+                                    uint32_t mip_levels) {
+  uint32_t ret = 0;
+  for (uint32_t level = 0; level < mip_levels; ++level) {
+    ret += CompressedLevelSize(format, size_u > level ? size_u - level : 0,
+                               size_v > level ? size_v - level : 0);
+  }
+  return ret;
+}
+
+// Allocates power of two texture memory for `image` in its current format. `byte_length` may be
+// used to reserve more than a single level, otherwise it should be 0. Returns false if the memory
+// could not be allocated.
+static bool TryAllocateImageStorage(GPU_Image* image, uint32_t byte_length) {
+  auto image_data = (PBKitImageData*)image->data;
+
+  uint16_t w = getNearestPowerOf2(image->w);
+  uint16_t h = getNearestPowerOf2(image->h);
+
+  image_data->size_u = bsf((int)w);
+  image_data->size_v = bsf((int)h);
+
+  if (IsCompressedFormat(image_data->format)) {
+    // Compressed levels are rows of 4x4 blocks.
+    image_data->byte_length =
+        CompressedLevelSize(image_data->format, image_data->size_u, image_data->size_v);
+    image_data->pitch = image_data->byte_length / (h > 4 ? h / 4 : 1);
+  } else {
+    image_data->pitch = w * image->bytes_per_pixel;
+    image_data->byte_length = image_data->pitch * h;
+  }
+  if (byte_length > image_data->byte_length) {
+    image_data->byte_length = byte_length;
+  }
+
+  image_data->mip_levels = 1;
+  image_data->linear = false;
+
+  image->texture_w = w;
+  image->texture_h = h;
+  return AllocateTextureMemory(image_data->byte_length, &image_data->data) != nullptr;
+}
+
+static void AllocateImageStorage(GPU_Image* image, uint32_t byte_length) {
+  bool allocated = TryAllocateImageStorage(image, byte_length);
+  PBKITSDLGPU_ASSERT(allocated);
+}
+
+// Allocates unpadded linear texture memory for `image` and switches it to the equivalent LU_IMAGE
+// format.
+static void AllocateLinearImageStorage(GPU_Image* image) {
+  auto image_data = (PBKitImageData*)image->data;
+
+  // Linear texture pitches must be a multiple of 64 bytes.
+  image_data->pitch = (image->w * image->bytes_per_pixel + 63) & ~63;
+  image_data->byte_length = image_data->pitch * image->h;
+  image_data->size_u = 0;
+  image_data->size_v = 0;
+  image_data->mip_levels = 1;
+  image_data->linear = true;
+
+  switch (image_data->format) {
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R8G8B8A8:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R8G8B8A8;
+    break;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8;
+    break;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R5G6B5;
+    break;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A1R5G5B5:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A1R5G5B5;
+    break;
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A4R4G4B4:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A4R4G4B4;
+    break;
+  default:
+    image_data->format = NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8B8G8R8;
+    break;
+  }
+
+  AllocateTextureMemory(image_data->byte_length, &image_data->data);
+  PBKITSDLGPU_ASSERT(image_data->data);
+
+  image->texture_w = image->w;
+  image->texture_h = image->h;
+}
+
 static GPU_Image* SDLCALL CreateImage(GPU_Renderer* renderer,
                                       Uint16 w,
                                       Uint16 h,
@@ -522,24 +858,7 @@ static GPU_Image* SDLCALL CreateImage(GPU_Renderer* renderer,
     return nullptr;
   }
 
-  auto image_data = (PBKitImageData*)result->data;
-
-  w = getNearestPowerOf2(result->w);
-  h = getNearestPowerOf2(result->h);
-
-  image_data->pitch = w * result->bytes_per_pixel;
-  image_data->byte_length = image_data->pitch * h;
-
-  image_data->size_u = bsf((int)w);
-  image_data->size_v = bsf((int)h);
-
-  image_data->data = static_cast<uint8_t*>(MmAllocateContiguousMemoryEx(
-      image_data->byte_length, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
-  PBKITSDLGPU_ASSERT(image_data->data);
-
-  result->texture_w = w;
-  result->texture_h = h;
-
+  AllocateImageStorage(result, 0);
   return result;
 }
 
@@ -550,9 +869,37 @@ static GPU_Image* SDLCALL CreateImageUsingTexture(GPU_Renderer* renderer,
   return nullptr;
 }
 
+static void FlushBlitBatchIfUsing(const GPU_Image* image);
+
 static GPU_Image* SDLCALL CreateAliasImage(GPU_Renderer* renderer, GPU_Image* image) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return nullptr;
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_CreateAliasImage", GPU_ERROR_NULL_ARGUMENT, "image");
+    return nullptr;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+
+  auto result = (GPU_Image*)SDL_malloc(sizeof(GPU_Image));
+  *result = *image;
+  result->refcount = 1;
+  result->target = nullptr;
+  result->is_alias = GPU_TRUE;
+
+  // The alias keeps its own copy of the image data so that its region of the texture may be
+  // changed independently, e.g. by the atlas packer.
+  auto data = (PBKitImageData*)SDL_malloc(sizeof(PBKitImageData));
+  *data = *image_data;
+  data->owner = owner;
+  data->managed = nullptr;
+  data->cached_texels = nullptr;
+  ++owner->refcount;
+  if (data->palette) {
+    RetainPalette(data->palette);
+  }
+  result->data = data;
+
+  return result;
 }
 
 static GPU_bool SDLCALL SaveImage(GPU_Renderer* renderer,
@@ -568,69 +915,287 @@ static GPU_Image* SDLCALL CopyImage(GPU_Renderer* renderer, GPU_Image* image) {
   return nullptr;
 }
 
+// Clips `rect` (the whole area if null) to a `max_w` x `max_h` area and returns it in whole texels.
+static SDL_Rect ClipUpdateRect(const GPU_Rect* rect, int max_w, int max_h) {
+  SDL_Rect ret = { 0, 0, max_w, max_h };
+  if (rect) {
+    ret = { (int)rect->x, (int)rect->y, (int)rect->w, (int)rect->h };
+    if (ret.x < 0) {
+      ret.w += ret.x;
+      ret.x = 0;
+    }
+    if (ret.y < 0) {
+      ret.h += ret.y;
+      ret.y = 0;
+    }
+    if (ret.x + ret.w > max_w) {
+      ret.w = max_w - ret.x;
+    }
+    if (ret.y + ret.h > max_h) {
+      ret.h = max_h - ret.y;
+    }
+  }
+  return ret;
+}
+
+// Byte offsets of the red, green, blue and alpha channels within a source pixel. Alpha is -1 if
+// the source has no alpha channel.
+struct SourceChannels {
+  int bytes_per_pixel;
+  int r, g, b, a;
+};
+
+// Describes `format` if it has 8 bit channels in whole bytes, as every 24 and 32 bit format does.
+static bool GetSurfaceChannels(const SDL_PixelFormat* format, SourceChannels* channels) {
+  auto byte_offset = [](Uint32 mask, Uint8 shift, int* offset) {
+    if (!mask) {
+      *offset = -1;
+      return true;
+    }
+    *offset = shift / 8;
+    return !(shift % 8) && mask == (0xFFu << shift);
+  };
+
+  channels->bytes_per_pixel = format->BytesPerPixel;
+  return (format->BytesPerPixel == 3 || format->BytesPerPixel == 4)
+         && byte_offset(format->Rmask, format->Rshift, &channels->r) && channels->r >= 0
+         && byte_offset(format->Gmask, format->Gshift, &channels->g) && channels->g >= 0
+         && byte_offset(format->Bmask, format->Bshift, &channels->b) && channels->b >= 0
+         && byte_offset(format->Amask, format->Ashift, &channels->a);
+}
+
+// Describes the byte layout SDL_gpu uses for raw pixel data of `format`.
+static SourceChannels GetFormatChannels(GPU_FormatEnum format) {
+  switch (format) {
+  case GPU_FORMAT_RGB:
+    return { 3, 0, 1, 2, -1 };
+  case GPU_FORMAT_BGR:
+    return { 3, 2, 1, 0, -1 };
+  case GPU_FORMAT_BGRA:
+    return { 4, 2, 1, 0, 3 };
+  case GPU_FORMAT_ABGR:
+    return { 4, 3, 2, 1, 0 };
+  default:
+    return { 4, 0, 1, 2, 3 };
+  }
+}
+
+// Returns the byte offsets of the channels within 32 bit texels of `texture_format`. 16 bit texels
+// are packed from A8R8G8B8.
+static SourceChannels GetTexelChannels(int texture_format) {
+  if (GetTexelPacking(texture_format) != TexelPacking::k8888) {
+    return { 4, 2, 1, 0, 3 };
+  }
+
+  switch (texture_format) {
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R8G8B8A8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_R8G8B8A8:
+    return { 4, 3, 2, 1, 0 };
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8:
+    return { 4, 2, 1, 0, 3 };
+  default:
+    return { 4, 0, 1, 2, 3 };
+  }
+}
+
+// Returns the conversion from `source` pixels to texels of `image_data`.
+static TexelConversion MakeTexelConversion(const SourceChannels& source,
+                                           const PBKitImageData& image_data) {
+  auto packing = GetTexelPacking(image_data.format);
+  auto texel = GetTexelChannels(image_data.format);
+
+  TexelConversion conversion;
+  conversion.bytes_per_pixel = source.bytes_per_pixel;
+  conversion.source_byte[texel.r] = source.r;
+  conversion.source_byte[texel.g] = source.g;
+  conversion.source_byte[texel.b] = source.b;
+  conversion.source_byte[texel.a] = source.a;
+  conversion.packing = packing;
+  conversion.dither = image_data.dither;
+  return conversion;
+}
+
+// Returns true if pixels of `format` already have the layout of the 16 bit texels of
+// `image_data`, so that they can be copied without conversion.
+static bool IsPackedTexelFormat(const SDL_PixelFormat* format, const PBKitImageData& image_data) {
+  switch (GetTexelPacking(image_data.format)) {
+  case TexelPacking::kR5G6B5:
+    return format->format == SDL_PIXELFORMAT_RGB565;
+  case TexelPacking::kA1R5G5B5:
+    return format->format == SDL_PIXELFORMAT_ARGB1555;
+  case TexelPacking::kA4R4G4B4:
+    return format->format == SDL_PIXELFORMAT_ARGB4444;
+  case TexelPacking::kI8:
+    return format->format == SDL_PIXELFORMAT_INDEX8;
+  default:
+    return false;
+  }
+}
+
+// Returns the conversion that copies pixels already in the texel layout of `image_data`.
+static TexelConversion MakeCopyConversion(const PBKitImageData& image_data) {
+  auto packing = GetTexelPacking(image_data.format);
+  return { texel_size(packing), { 0, 1, 2, 3 }, packing };
+}
+
+// Writes the `w` x `h` block of pixels at `source` to (`x`, `y`) in `image`, whose texture memory
+// is at `texture`, converting them to the texture format on the way and touching only the texture
+// memory that holds the block.
+//
+// Swizzled images whose texture is larger than the image get their padding texels next to the
+// right and bottom edges filled when the filter mode would otherwise blend them in at the edge.
+// They repeat the opposite edge for GPU_WRAP_REPEAT and the edge itself otherwise.
+static void WriteImageRegion(GPU_Image* image,
+                             uint8_t* texture,
+                             int x,
+                             int y,
+                             int w,
+                             int h,
+                             const uint8_t* source,
+                             int source_pitch,
+                             const TexelConversion& conversion) {
+  auto image_data = (PBKitImageData*)image->data;
+  PBKITSDLGPU_ASSERT((uint32_t)image->bytes_per_pixel == conversion.TexelSize());
+
+  auto bpp = conversion.bytes_per_pixel;
+
+  if (image_data->linear) {
+    // Linear images share the source's row layout.
+    int texture_x = x + image_data->offset_x;
+    int texture_y = y + image_data->offset_y;
+    PbkitSdlGpu::convert_rect(source, w, h,
+                              texture + texture_y * image_data->pitch
+                                  + texture_x * image->bytes_per_pixel,
+                              source_pitch, image_data->pitch, conversion, texture_x, texture_y);
+    return;
+  }
+
+  auto write = [&](const uint8_t* block, int block_x, int block_y, int block_w, int block_h) {
+    PbkitSdlGpu::swizzle_subrect_convert(block, block_x + image_data->offset_x,
+                                         block_y + image_data->offset_y, block_w, block_h, texture,
+                                         image->texture_w, image->texture_h, source_pitch,
+                                         conversion);
+  };
+  write(source, x, y, w, h);
+
+  bool pad_x = image->w < image->texture_w;
+  bool pad_y = image->h < image->texture_h;
+  if ((!pad_x && !pad_y) || image->filter_mode == GPU_FILTER_NEAREST || image_data->offset_x
+      || image_data->offset_y) {
+    return;
+  }
+
+  // The image column and row copied into the padding, relative to the updated block.
+  int column = (image->wrap_mode_x == GPU_WRAP_REPEAT ? 0 : image->w - 1) - x;
+  int row = (image->wrap_mode_y == GPU_WRAP_REPEAT ? 0 : image->h - 1) - y;
+  bool has_column = pad_x && column >= 0 && column < w;
+  bool has_row = pad_y && row >= 0 && row < h;
+
+  if (has_column) {
+    write(source + column * bpp, image->w, y, 1, h);
+  }
+  if (has_row) {
+    write(source + row * source_pitch, x, image->h, w, 1);
+  }
+  if (has_column && has_row) {
+    write(source + row * source_pitch + column * bpp, image->w, image->h, 1, 1);
+  }
+}
+
+// Picks the conversion from the pixels of `surface` to the texels of `image`, pushing an error on
+// behalf of `function` if there is none.
+static bool GetSurfaceConversion(const char* function,
+                                 const GPU_Image* image,
+                                 SDL_Surface* surface,
+                                 TexelConversion* conversion) {
+  auto image_data = (PBKitImageData*)image->data;
+  if (IsCompressedFormat(image_data->format)) {
+    GPU_PushErrorCode(function, GPU_ERROR_USER_ERROR, "Compressed images cannot be updated");
+    return false;
+  }
+
+  SourceChannels source_channels;
+  if (IsPackedTexelFormat(surface->format, *image_data)) {
+    *conversion = MakeCopyConversion(*image_data);
+  } else if (image_data->palette) {
+    GPU_PushErrorCode(function, GPU_ERROR_DATA_ERROR,
+                      "Paletted images can only be updated from 8 bit indexed surfaces");
+    return false;
+  } else if (GetSurfaceChannels(surface->format, &source_channels)) {
+    *conversion = MakeTexelConversion(source_channels, *image_data);
+  } else {
+    GPU_PushErrorCode(function, GPU_ERROR_DATA_ERROR,
+                      "Unsupported surface format (%d bytes per pixel)",
+                      surface->format->BytesPerPixel);
+    return false;
+  }
+  return true;
+}
+
+// Clips an update of `image_rect` in `image` from `surface_rect` in `surface` to both of them.
+// Returns false if nothing is left, otherwise the area of the image to write and the first source
+// pixel for it.
+static bool ClipSurfaceUpdate(const GPU_Image* image,
+                              const GPU_Rect* image_rect,
+                              SDL_Surface* surface,
+                              const GPU_Rect* surface_rect,
+                              const TexelConversion& conversion,
+                              SDL_Rect* dest_rect,
+                              const uint8_t** source) {
+  *dest_rect = ClipUpdateRect(image_rect, image->w, image->h);
+  auto source_rect = ClipUpdateRect(surface_rect, surface->w, surface->h);
+  dest_rect->w = dest_rect->w < source_rect.w ? dest_rect->w : source_rect.w;
+  dest_rect->h = dest_rect->h < source_rect.h ? dest_rect->h : source_rect.h;
+  if (dest_rect->w <= 0 || dest_rect->h <= 0) {
+    return false;
+  }
+
+  *source = static_cast<const uint8_t*>(surface->pixels) + surface->pitch * source_rect.y
+            + source_rect.x * conversion.bytes_per_pixel;
+  return true;
+}
+
+static void CompleteUploads(const PBKitImageData* owner);
+
 static void SDLCALL UpdateImage(GPU_Renderer* renderer,
                                 GPU_Image* image,
                                 const GPU_Rect* image_rect,
                                 SDL_Surface* surface,
                                 const GPU_Rect* surface_rect) {
-  PBKITSDLGPU_ASSERT(!image_rect);
-
-  GPU_Rect fallback_surface_rect;
-  if (!surface_rect) {
-    fallback_surface_rect = { 0.0f, 0.0f, (float)surface->w, (float)surface->h };
-    surface_rect = &fallback_surface_rect;
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_UpdateImage", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+  if (surface == nullptr) {
+    GPU_PushErrorCode("GPU_UpdateImage", GPU_ERROR_NULL_ARGUMENT, "surface");
+    return;
+  }
+  TexelConversion conversion;
+  if (!GetSurfaceConversion("GPU_UpdateImage", image, surface, &conversion)) {
+    return;
   }
 
-  auto image_data = (PBKitImageData*)image->data;
-  auto source = static_cast<uint8_t*>(surface->pixels);
-  bool free_source_needed = false;
-  auto source_pitch = surface->pitch;
-  auto source_bpp = surface->format->BytesPerPixel;
-
-  if (image->w != image->texture_w || surface->format->BytesPerPixel == 3) {
-    free_source_needed = true;
-    PBKITSDLGPU_ASSERT(image->bytes_per_pixel == 4);
-    auto padded_dest = (uint8_t*)SDL_malloc(image_data->byte_length);
-    PBKITSDLGPU_ASSERT(padded_dest);
-    auto dest = padded_dest;
-
-    source_bpp = image->bytes_per_pixel;
-    source_pitch = image_data->pitch;
-
-    source += surface->pitch * (int)surface_rect->y + (int)surface_rect->x;
-
-    if (surface->format->BytesPerPixel == 3) {
-      for (uint32_t y = 0; y < surface_rect->h; ++y) {
-        auto spixel = source;
-        auto dpixel = dest;
-        for (uint32_t x = 0; x < surface_rect->w; ++x) {
-          *dpixel++ = *spixel++;
-          *dpixel++ = *spixel++;
-          *dpixel++ = *spixel++;
-          *dpixel++ = 0xFF;
-        }
-        source += surface->pitch;
-        dest += image_data->pitch;
-      }
-    } else {
-      uint32_t bytes_per_row = surface->format->BytesPerPixel * surface_rect->w;
-      for (uint32_t y = 0; y < surface_rect->h; ++y) {
-        // TODO: Support image_rect.
-        memcpy(dest, source, bytes_per_row);
-        source += surface->pitch;
-        dest += image_data->pitch;
-      }
-    }
+  SDL_Rect dest_rect;
+  const uint8_t* source;
+  if (!ClipSurfaceUpdate(image, image_rect, surface, surface_rect, conversion, &dest_rect,
+                         &source)) {
+    return;
+  }
 
-    source = padded_dest;
+  if (!MakeImageResident(image)) {
+    return;
   }
 
-  PbkitSdlGpu::swizzle_rect(source, image->texture_w, image->texture_h, image_data->data, source_pitch,
-               source_bpp);
+  // Pending blits must sample the old contents, and queued updates must not overwrite this one.
+  renderer->impl->FlushBlitBuffer(renderer);
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  CompleteUploads(owner);
+  owner->DropCachedTexels();
 
-  if (free_source_needed) {
-    SDL_free(source);
-  }
+  WriteImageRegion(image, image_data->TextureData(), dest_rect.x, dest_rect.y, dest_rect.w,
+                   dest_rect.h, source, surface->pitch, conversion);
 }
 
 static void SDLCALL UpdateImageBytes(GPU_Renderer* renderer,
@@ -638,7 +1203,40 @@ static void SDLCALL UpdateImageBytes(GPU_Renderer* renderer,
                                      const GPU_Rect* image_rect,
                                      const unsigned char* bytes,
                                      int bytes_per_row) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_UpdateImageBytes", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+  if (bytes == nullptr) {
+    GPU_PushErrorCode("GPU_UpdateImageBytes", GPU_ERROR_NULL_ARGUMENT, "bytes");
+    return;
+  }
+  if (IsCompressedFormat(((PBKitImageData*)image->data)->format)) {
+    GPU_PushErrorCode("GPU_UpdateImageBytes", GPU_ERROR_USER_ERROR, "Compressed images cannot be updated");
+    return;
+  }
+
+  auto dest_rect = ClipUpdateRect(image_rect, image->w, image->h);
+  if (dest_rect.w <= 0 || dest_rect.h <= 0) {
+    return;
+  }
+
+  if (!MakeImageResident(image)) {
+    return;
+  }
+
+  renderer->impl->FlushBlitBuffer(renderer);
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  CompleteUploads(owner);
+  owner->DropCachedTexels();
+
+  // The bytes are in the layout of the image's SDL_gpu format, or palette indices.
+  auto conversion = image_data->palette
+                        ? MakeCopyConversion(*image_data)
+                        : MakeTexelConversion(GetFormatChannels(image->format), *image_data);
+  WriteImageRegion(image, image_data->TextureData(), dest_rect.x, dest_rect.y, dest_rect.w,
+                   dest_rect.h, bytes, bytes_per_row, conversion);
 }
 
 static GPU_bool SDLCALL ReplaceImage(GPU_Renderer* renderer,
@@ -649,6 +1247,23 @@ static GPU_bool SDLCALL ReplaceImage(GPU_Renderer* renderer,
   return false;
 }
 
+// Creates an I8 image sampling from `palette`.
+static GPU_Image* CreatePalettedImage(GPU_Renderer* renderer,
+                                      Uint16 w,
+                                      Uint16 h,
+                                      Palette* palette) {
+  auto image = CreateUninitializedImage(renderer, w, h, GPU_FORMAT_LUMINANCE,
+                                        NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8);
+  if (!image) {
+    return nullptr;
+  }
+
+  RetainPalette(palette);
+  ((PBKitImageData*)image->data)->palette = palette;
+  AllocateImageStorage(image, 0);
+  return image;
+}
+
 static GPU_Image* SDLCALL CopyImageFromSurface(GPU_Renderer* renderer,
                                                SDL_Surface* surface,
                                                GPU_Rect* surface_rect) {
@@ -666,6 +1281,28 @@ static GPU_Image* SDLCALL CopyImageFromSurface(GPU_Renderer* renderer,
   int sw = !surface_rect ? surface->w : surface_rect->w;
   int sh = !surface_rect ? surface->h : surface_rect->h;
 
+  // Indexed surfaces keep their indices and get a palette of their own.
+  if (surface->format->format == SDL_PIXELFORMAT_INDEX8 && surface->format->palette) {
+    SDL_Color colors[256];
+    int count = surface->format->palette->ncolors < 256 ? surface->format->palette->ncolors : 256;
+    memcpy(colors, surface->format->palette->colors, count * sizeof(SDL_Color));
+    Uint32 color_key;
+    if (!SDL_GetColorKey(surface, &color_key) && color_key < (Uint32)count) {
+      colors[color_key].a = 0;
+    }
+
+    auto palette = CreatePalette(colors, count);
+    if (!palette) {
+      return nullptr;
+    }
+    auto image = CreatePalettedImage(renderer, (Uint16)sw, (Uint16)sh, palette);
+    ReleasePalette(palette);
+    if (image) {
+      renderer->impl->UpdateImage(renderer, image, nullptr, surface, surface_rect);
+    }
+    return image;
+  }
+
   // See what the best image format is.
   GPU_FormatEnum format;
   if (surface->format->Amask == 0) {
@@ -689,26 +1326,363 @@ static GPU_Image* SDLCALL CopyImageFromSurface(GPU_Renderer* renderer,
   return image;
 }
 
+// The copy is made by the CPU, so it waits for the GPU to finish everything drawn so far.
 static GPU_Image* SDLCALL CopyImageFromTarget(GPU_Renderer* renderer, GPU_Target* target) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return nullptr;
-}
-
-static SDL_Surface* SDLCALL CopySurfaceFromTarget(GPU_Renderer* renderer,
-                                                  GPU_Target* target) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return nullptr;
-}
+  if (target == nullptr) {
+    GPU_PushErrorCode("GPU_CopyImageFromTarget", GPU_ERROR_NULL_ARGUMENT, "target");
+    return nullptr;
+  }
 
-static SDL_Surface* SDLCALL CopySurfaceFromImage(GPU_Renderer* renderer, GPU_Image* image) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return nullptr;
-}
+  renderer->impl->FlushBlitBuffer(renderer);
+  WaitForFence(InsertFence());
 
-static void SDLCALL FreeImage(GPU_Renderer* renderer, GPU_Image* image) {
+  auto source = target->image;
+  if (!source && !target->context) {
+    GPU_PushErrorCode("GPU_CopyImageFromTarget", GPU_ERROR_USER_ERROR,
+                      "The target's image has been freed");
+    return nullptr;
+  }
+  if (!source) {
+    auto context = static_cast<PBKitSDLContext*>(target->context->data);
+    auto surface = SDL_CreateRGBSurfaceWithFormatFrom(pb_back_buffer(), context->width,
+                                                      context->height, 32, context->width * 4,
+                                                      SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+      GPU_PushErrorCode("GPU_CopyImageFromTarget", GPU_ERROR_BACKEND_ERROR,
+                        "Failed to wrap the back buffer");
+      return nullptr;
+    }
+    auto image = CopyImageFromSurface(renderer, surface, nullptr);
+    SDL_FreeSurface(surface);
+    return image;
+  }
+
+  if (!MakeImageResident(source)) {
+    return nullptr;
+  }
+
+  // Targets own their texture memory in a renderable format, which is copied as is.
+  auto source_data = (PBKitImageData*)source->data;
+  auto image =
+      CreateUninitializedImage(renderer, source->w, source->h, source->format, source_data->format);
+  if (!image) {
+    return nullptr;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  image_data->pitch = source_data->pitch;
+  image_data->byte_length = source_data->byte_length;
+  image_data->size_u = source_data->size_u;
+  image_data->size_v = source_data->size_v;
+  image_data->mip_levels = source_data->mip_levels;
+  image_data->linear = source_data->linear;
+  image->texture_w = source->texture_w;
+  image->texture_h = source->texture_h;
+  image->has_mipmaps = source->has_mipmaps;
+  image->filter_mode = source->filter_mode;
+
+  if (!AllocateTextureMemory(image_data->byte_length, &image_data->data)) {
+    GPU_PushErrorCode("GPU_CopyImageFromTarget", GPU_ERROR_BACKEND_ERROR,
+                      "Failed to allocate %u bytes of texture memory", image_data->byte_length);
+    renderer->impl->FreeImage(renderer, image);
+    return nullptr;
+  }
+  memcpy(image_data->data, source_data->data, image_data->byte_length);
+  return image;
+}
+
+static SDL_Surface* SDLCALL CopySurfaceFromTarget(GPU_Renderer* renderer,
+                                                  GPU_Target* target) {
+  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  return nullptr;
+}
+
+static SDL_Surface* SDLCALL CopySurfaceFromImage(GPU_Renderer* renderer, GPU_Image* image) {
   PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  return nullptr;
+}
+
+static void SDLCALL FreeImage(GPU_Renderer* renderer, GPU_Image* image) {
+  if (image == nullptr) {
+    return;
+  }
+
+  if (image->refcount > 1) {
+    --image->refcount;
+    return;
+  }
+
+  FlushBlitBatchIfUsing(image);
+  // A target the caller still holds outlives the texture it draws into, detached from it, until
+  // GPU_FreeTarget releases it.
+  if (image->target) {
+    auto target = image->target;
+    renderer->impl->FlushBlitBuffer(renderer);
+    if (bound_target_image == image) {
+      BindBackBuffer(GetWindowContext(renderer));
+    }
+    image->target = nullptr;
+    target->image = nullptr;
+    if (!target->refcount) {
+      renderer->impl->FreeTarget(renderer, target);
+    }
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  if (image_data->palette) {
+    ReleasePalette(image_data->palette);
+    image_data->palette = nullptr;
+  }
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  if (image_data != owner) {
+    SDL_free(image_data);
+  } else {
+    StopManagingImage(image);
+  }
+
+  if (!--owner->refcount) {
+    FreeTextureMemory(owner->data);
+    owner->DropCachedTexels();
+    SDL_free(owner);
+  }
+
+  SDL_free(image);
+}
+
+// An update queued by PBKitSDLGPUQueueImageUpdate. The texels are written into a shadow copy of
+// the texture a slice at a time, and the image switches to the copy once it is complete. The old
+// texture memory is retired behind a fence, so draws already pushed keep sampling it.
+struct PendingUpload {
+  // Both are retained until the upload is finished.
+  GPU_Image* image;
+  SDL_Surface* surface;
+  SDL_Rect dest_rect;
+  const uint8_t* source;
+  TexelConversion conversion;
+  // Replacement texture memory, owned by the upload until it is handed to the image.
+  uint8_t* shadow;
+  uint32_t byte_length;
+  // Bytes of the current texture copied into the shadow, for updates that do not replace all of it.
+  uint32_t copied_bytes;
+  // The owner's cached texels while they are first read back, handed to the owner once complete.
+  uint8_t* new_cached_texels;
+  int written_rows;
+};
+
+static constexpr uint32_t kUploadCopySliceSize = 64 * 1024;
+static constexpr uint32_t kUploadWriteSliceSize = 16 * 1024;
+
+// Oldest first. Uploads are worked on in order so that later updates of a texture start from the
+// result of earlier ones.
+static std::vector<PendingUpload*> pending_uploads;
+static uint32_t upload_time_budget_us = 2000;
+
+static void ReleaseUpload(PendingUpload* upload) {
+  FreeTextureMemory(upload->shadow);
+  SDL_free(upload->new_cached_texels);
+  SDL_FreeSurface(upload->surface);
+  FreeImage(upload->image->renderer, upload->image);
+  delete upload;
+}
+
+// Does the next slice of work on `upload`. Returns true once it has been applied, or dropped
+// because its texture was evicted.
+static bool AdvanceUpload(PendingUpload* upload) {
+  auto image = upload->image;
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  if (!owner->data) {
+    // Evicted textures are refilled from their restore source, which the update is not part of.
+    return true;
+  }
+  TouchImage(owner);
+
+  const auto& rect = upload->dest_rect;
+  if (!upload->shadow) {
+    upload->byte_length = owner->byte_length;
+    if (!AllocateTextureMemory(upload->byte_length, &upload->shadow)) {
+      GPU_PushErrorCode("PBKitSDLGPUQueueImageUpdate", GPU_ERROR_BACKEND_ERROR,
+                        "Failed to allocate %u bytes of texture memory", upload->byte_length);
+      return true;
+    }
+
+    // Only an update of all of a texture without mipmaps can skip copying the current contents.
+    bool replaces_texture = image_data == owner && owner->mip_levels == 1 && !rect.x && !rect.y
+                            && rect.w == image->w && rect.h == image->h;
+    upload->copied_bytes = replaces_texture ? upload->byte_length : 0;
+
+    // Write-combined texture memory is slow to read, so it is read back once and later updates copy
+    // from cached memory. Render targets change without the CPU knowing and are always read back.
+    if (!replaces_texture && !owner->cached_texels && !image->target) {
+      upload->new_cached_texels = (uint8_t*)SDL_malloc(upload->byte_length);
+    }
+    return false;
+  }
+
+  if (upload->copied_bytes < upload->byte_length) {
+    uint32_t offset = upload->copied_bytes;
+    uint32_t size = upload->byte_length - offset;
+    size = size < kUploadCopySliceSize ? size : kUploadCopySliceSize;
+    const uint8_t* texels = owner->cached_texels;
+    if (!texels && upload->new_cached_texels) {
+      memcpy(upload->new_cached_texels + offset, owner->data + offset, size);
+      texels = upload->new_cached_texels;
+    }
+    memcpy(upload->shadow + offset, (texels ? texels : owner->data) + offset, size);
+    upload->copied_bytes += size;
+
+    if (upload->copied_bytes == upload->byte_length && upload->new_cached_texels) {
+      owner->cached_texels = upload->new_cached_texels;
+      upload->new_cached_texels = nullptr;
+    }
+    return false;
+  }
+
+  if (upload->written_rows < rect.h) {
+    int rows = kUploadWriteSliceSize / (rect.w * image->bytes_per_pixel);
+    rows = rows < 1 ? 1 : rows;
+    rows = rows < rect.h - upload->written_rows ? rows : rect.h - upload->written_rows;
+    auto source = upload->source + upload->written_rows * upload->surface->pitch;
+    int y = rect.y + upload->written_rows;
+    WriteImageRegion(image, upload->shadow, rect.x, y, rect.w, rows, source,
+                     upload->surface->pitch, upload->conversion);
+    // The cached texels follow the shadow, so the next update starts from this one.
+    if (owner->cached_texels) {
+      WriteImageRegion(image, owner->cached_texels, rect.x, y, rect.w, rows, source,
+                       upload->surface->pitch, upload->conversion);
+    }
+    upload->written_rows += rows;
+    return false;
+  }
+
+  // Anything that resizes the texture completes pending uploads first.
+  PBKITSDLGPU_ASSERT(owner->byte_length == upload->byte_length);
+  _mm_sfence();
+  auto old_data = owner->data;
+  TransferTextureMemory(upload->shadow, &owner->data);
+  upload->shadow = nullptr;
+  FreeTextureMemory(old_data);
+  return true;
 }
 
+// Works on queued uploads until they are done or the frame's time budget is used up.
+static void ProcessUploads() {
+  if (pending_uploads.empty()) {
+    return;
+  }
+
+  uint64_t start = SDL_GetPerformanceCounter();
+  uint64_t budget = SDL_GetPerformanceFrequency() * upload_time_budget_us / 1000000;
+  size_t finished = 0;
+  do {
+    if (AdvanceUpload(pending_uploads[finished])) {
+      ReleaseUpload(pending_uploads[finished]);
+      ++finished;
+    }
+  } while (finished < pending_uploads.size() && SDL_GetPerformanceCounter() - start < budget);
+  pending_uploads.erase(pending_uploads.begin(), pending_uploads.begin() + finished);
+}
+
+// Finishes every queued upload up to the last one that writes to the texture of `owner`, or all of
+// them if `owner` is null.
+static void CompleteUploads(const PBKitImageData* owner) {
+  size_t count = 0;
+  for (size_t i = 0; i < pending_uploads.size(); ++i) {
+    auto image_data = (PBKitImageData*)pending_uploads[i]->image->data;
+    if (!owner || (image_data->owner ? image_data->owner : image_data) == owner) {
+      count = i + 1;
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    while (!AdvanceUpload(pending_uploads[i])) {
+    }
+    ReleaseUpload(pending_uploads[i]);
+  }
+  pending_uploads.erase(pending_uploads.begin(), pending_uploads.begin() + count);
+}
+
+static bool QueueImageUpdate(GPU_Image* image,
+                             const GPU_Rect* image_rect,
+                             SDL_Surface* surface,
+                             const GPU_Rect* surface_rect) {
+  if (image == nullptr) {
+    GPU_PushErrorCode("PBKitSDLGPUQueueImageUpdate", GPU_ERROR_NULL_ARGUMENT, "image");
+    return false;
+  }
+  if (surface == nullptr) {
+    GPU_PushErrorCode("PBKitSDLGPUQueueImageUpdate", GPU_ERROR_NULL_ARGUMENT, "surface");
+    return false;
+  }
+
+  TexelConversion conversion;
+  if (!GetSurfaceConversion("PBKitSDLGPUQueueImageUpdate", image, surface, &conversion)) {
+    return false;
+  }
+
+  SDL_Rect dest_rect;
+  const uint8_t* source;
+  if (!ClipSurfaceUpdate(image, image_rect, surface, surface_rect, conversion, &dest_rect,
+                         &source)) {
+    return true;
+  }
+
+  if (!MakeImageResident(image)) {
+    return false;
+  }
+
+  ++image->refcount;
+  ++surface->refcount;
+  pending_uploads.push_back(
+      new PendingUpload{ image, surface, dest_rect, source, conversion, nullptr, 0, 0, nullptr, 0 });
+  return true;
+}
+
+static bool IsUploadPending(const GPU_Image* image) {
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  for (auto upload : pending_uploads) {
+    auto upload_data = (PBKitImageData*)upload->image->data;
+    if ((upload_data->owner ? upload_data->owner : upload_data) == owner) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Switches the texels of a 32 bit image to A8R8G8B8, the only 32 bit layout the color surface can
+// write. Returns false if the image has no renderable equivalent. This waits for the GPU and
+// rewrites the whole texture, which PBKitSDLGPUCreateTargetImage avoids by starting in A8R8G8B8.
+static bool ConvertToRenderableFormat(GPU_Image* image) {
+  auto image_data = (PBKitImageData*)image->data;
+  if (GetSurfaceColorFormat(image_data->format)) {
+    return true;
+  }
+  if (IsCompressedFormat(image_data->format)
+      || GetTexelPacking(image_data->format) != TexelPacking::k8888) {
+    return false;
+  }
+
+  // Draws already pushed sample the current texels.
+  WaitForFence(InsertFence());
+  auto texels = (uint8_t*)SDL_malloc(image_data->byte_length);
+  if (!texels) {
+    return false;
+  }
+  memcpy(texels, image_data->data, image_data->byte_length);
+
+  auto channels = GetTexelChannels(image_data->format);
+  image_data->format = image_data->linear ? NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8
+                                          : NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8;
+  // Every texel is converted in place, so the layout of the texture does not matter.
+  convert_rect(texels, image_data->byte_length / 4, 1, image_data->data, image_data->byte_length,
+               image_data->byte_length, MakeTexelConversion(channels, *image_data));
+  SDL_free(texels);
+  return true;
+}
+
+// Only the first level of the texture is rendered into. Mipmaps have to be generated again once
+// rendering is done.
 static GPU_Target* SDLCALL GetTarget(GPU_Renderer* renderer, GPU_Image* image) {
   if(!image)
     return nullptr;
@@ -719,12 +1693,72 @@ static GPU_Target* SDLCALL GetTarget(GPU_Renderer* renderer, GPU_Image* image) {
   if(!(renderer->enabled_features & GPU_FEATURE_RENDER_TARGETS))
     return nullptr;
 
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
-  return nullptr;
+  auto image_data = (PBKitImageData*)image->data;
+  if (image_data->owner || image_data->refcount > 1) {
+    GPU_PushErrorCode("GPU_GetTarget", GPU_ERROR_USER_ERROR,
+                      "Images that share texture memory cannot be render targets");
+    return nullptr;
+  }
+  if (!MakeImageResident(image)) {
+    return nullptr;
+  }
+
+  FlushBlitBatchIfUsing(image);
+  CompleteUploads(image_data);
+  // Drawing changes the texels without the CPU knowing.
+  image_data->DropCachedTexels();
+  if (!ConvertToRenderableFormat(image)) {
+    GPU_PushErrorCode("GPU_GetTarget", GPU_ERROR_USER_ERROR,
+                      "Texture format 0x%x cannot be rendered into", image_data->format);
+    return nullptr;
+  }
+
+  auto target = (GPU_Target*)SDL_malloc(sizeof(GPU_Target));
+  memset(target, 0, sizeof(GPU_Target));
+  // GPU_LoadTarget takes the first reference.
+  target->refcount = 0;
+  target->renderer = renderer;
+  target->is_alias = GPU_FALSE;
+  target->image = image;
+  target->context = nullptr;
+  target->w = image->w;
+  target->h = image->h;
+  target->base_w = image->w;
+  target->base_h = image->h;
+  target->viewport = GPU_MakeRect(0, 0, image->w, image->h);
+  target->camera = GPU_GetDefaultCamera();
+  target->use_camera = GPU_TRUE;
+  target->use_color = GPU_FALSE;
+
+  image->target = target;
+  return target;
 }
 
 static void SDLCALL FreeTarget(GPU_Renderer* renderer, GPU_Target* target) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  if (target == nullptr) {
+    return;
+  }
+
+  if (target->refcount > 1) {
+    --target->refcount;
+    return;
+  }
+
+  // The window target lives as long as the renderer.
+  if (target->context) {
+    return;
+  }
+
+  renderer->impl->FlushBlitBuffer(renderer);
+  if (target->image) {
+    if (bound_target_image == target->image) {
+      BindBackBuffer(GetWindowContext(renderer));
+    }
+    if (target->image->target == target) {
+      target->image->target = nullptr;
+    }
+  }
+  SDL_free(target);
 }
 
 static void SDLCALL Blit(GPU_Renderer* renderer,
@@ -815,11 +1849,11 @@ static void UnbindTexture(uint32_t stage = 0) {
   PBKITSDLGPU_ASSERT(stage < 4);
   auto p = pb_begin();
   // NV097_SET_TEXTURE_CONTROL0
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage), 0);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage), 0);
 
   // TODO: Store the texture stage programs so more than one stage may be used.
   PBKITSDLGPU_ASSERT(stage == 0);
-  p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, 0);
+  p = PushState(p, NV097_SET_SHADER_STAGE_PROGRAM, 0);
   pb_end(p);
 
   SetInputColorCombiner(0, SRC_DIFFUSE, false, MAP_UNSIGNED_IDENTITY, SRC_ZERO, false,
@@ -828,6 +1862,24 @@ static void UnbindTexture(uint32_t stage = 0) {
                         MAP_UNSIGNED_INVERT);
 }
 
+// Returns the address mode for an axis of `image`. The texture only wraps at the image's edge if
+// there is no padding along the axis, and linear textures cannot wrap at all.
+static WrapMode GetWrapMode(const GPU_Image* image, GPU_WrapEnum wrap_mode, uint32_t size,
+                            uint32_t texture_size) {
+  if (size != texture_size || ((const PBKitImageData*)image->data)->linear) {
+    return WRAP_CLAMP_TO_EDGE;
+  }
+
+  switch (wrap_mode) {
+  case GPU_WRAP_REPEAT:
+    return WRAP_REPEAT;
+  case GPU_WRAP_MIRRORED:
+    return WRAP_MIRROR;
+  default:
+    return WRAP_CLAMP_TO_EDGE;
+  }
+}
+
 static void BindTexture(GPU_Image* image, uint32_t stage = 0) {
   PBKITSDLGPU_ASSERT(stage < 4);
   // TODO: Store the texture stage programs so more than one stage may be used.
@@ -843,10 +1895,11 @@ static void BindTexture(GPU_Image* image, uint32_t stage = 0) {
   const uint32_t DMA_A = 1;
 
   auto image_data = (PBKitImageData*)image->data;
+  TouchImage(image_data->owner ? image_data->owner : image_data);
 
   // NV097_SET_TEXTURE_OFFSET
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_OFFSET(stage),
-               (intptr_t)image_data->data & 0x03ffffff);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_OFFSET(stage),
+                (intptr_t)image_data->TextureData() & 0x03ffffff);
 
   uint32_t format = MASK(NV097_SET_TEXTURE_FORMAT_CONTEXT_DMA, DMA_A)
                     | MASK(NV097_SET_TEXTURE_FORMAT_CUBEMAP_ENABLE, 0)
@@ -854,51 +1907,258 @@ static void BindTexture(GPU_Image* image, uint32_t stage = 0) {
                            NV097_SET_TEXTURE_FORMAT_BORDER_SOURCE_COLOR)
                     | MASK(NV097_SET_TEXTURE_FORMAT_DIMENSIONALITY, 2)
                     | MASK(NV097_SET_TEXTURE_FORMAT_COLOR, image_data->format)
-                    | MASK(NV097_SET_TEXTURE_FORMAT_MIPMAP_LEVELS, 1)
+                    | MASK(NV097_SET_TEXTURE_FORMAT_MIPMAP_LEVELS, image_data->mip_levels)
                     | MASK(NV097_SET_TEXTURE_FORMAT_BASE_SIZE_U, image_data->size_u)
                     | MASK(NV097_SET_TEXTURE_FORMAT_BASE_SIZE_V, image_data->size_v)
                     | MASK(NV097_SET_TEXTURE_FORMAT_BASE_SIZE_P, 0);
   // NV097_SET_TEXTURE_FORMAT
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_FORMAT(stage), format);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_FORMAT(stage), format);
+
+  if (image_data->palette) {
+    // Switching palettes only changes this register.
+    p = PushState(p, NV097_SET_TEXTURE_PALETTE + stage * 64,
+                  GetPaletteRegisterValue(image_data->palette));
+  }
 
   uint32_t pitch_param = (image_data->pitch) << 16;
   // NV097_SET_TEXTURE_CONTROL1
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_PITCH(stage), pitch_param);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_PITCH(stage), pitch_param);
 
   uint32_t size_param = (image->texture_w << 16) | (image->texture_h & 0xFFFF);
   // NV097_SET_TEXTURE_IMAGE_RECT
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_SIZE(stage), size_param);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_SIZE(stage), size_param);
 
   // NV097_SET_TEXTURE_ADDRESS
-  uint32_t texture_address = MASK(NV097_SET_TEXTURE_ADDRESS_U, WRAP_CLAMP_TO_EDGE)
+  auto wrap_u = GetWrapMode(image, image->wrap_mode_x, image->w, image->texture_w);
+  auto wrap_v = GetWrapMode(image, image->wrap_mode_y, image->h, image->texture_h);
+  uint32_t texture_address = MASK(NV097_SET_TEXTURE_ADDRESS_U, wrap_u)
                              | MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_U, false)
-                             | MASK(NV097_SET_TEXTURE_ADDRESS_V, WRAP_CLAMP_TO_EDGE)
+                             | MASK(NV097_SET_TEXTURE_ADDRESS_V, wrap_v)
                              | MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_V, false)
                              | MASK(NV097_SET_TEXTURE_ADDRESS_P, WRAP_CLAMP_TO_EDGE)
                              | MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_P, false)
                              | MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_Q, false);
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_WRAP(stage), texture_address);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_WRAP(stage), texture_address);
 
   // NV097_SET_TEXTURE_FILTER
+  // Minification blends between mip levels whenever the image has them, and picks the nearest
+  // level for nearest filtering.
+  bool nearest = image->filter_mode == GPU_FILTER_NEAREST;
+  uint32_t min_filter = nearest ? MIN_BOX_LOD0 : MIN_TENT_LOD0;
+  if (image->has_mipmaps && image_data->mip_levels > 1) {
+    min_filter = nearest ? MIN_BOX_NEARESTLOD : MIN_TENT_TENT_LOD;
+  }
   uint32_t texture_filter = MASK(NV097_SET_TEXTURE_FILTER_MIPMAP_LOD_BIAS, 0)
                             | MASK(NV097_SET_TEXTURE_FILTER_CONVOLUTION_KERNEL, K_QUINCUNX)
-                            | MASK(NV097_SET_TEXTURE_FILTER_MIN, MIN_TENT_LOD0)
-                            | MASK(NV097_SET_TEXTURE_FILTER_MAG, MAG_TENT_LOD0);
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_FILTER(stage), texture_filter);
+                            | MASK(NV097_SET_TEXTURE_FILTER_MIN, min_filter)
+                            | MASK(NV097_SET_TEXTURE_FILTER_MAG, nearest ? MAG_BOX_LOD0 : MAG_TENT_LOD0);
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_FILTER(stage), texture_filter);
 
-  p = pb_push1(p, NV097_SET_TEXTURE_MATRIX_ENABLE + (4 * stage), false);
+  p = PushState(p, NV097_SET_TEXTURE_MATRIX_ENABLE + (4 * stage), false);
 
   // NV097_SET_TEXTURE_CONTROL0
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage),
-               NV097_SET_TEXTURE_CONTROL0_ENABLE
-                   | MASK(NV097_SET_TEXTURE_CONTROL0_ALPHA_KILL_ENABLE, false)
-                   | MASK(NV097_SET_TEXTURE_CONTROL0_MIN_LOD_CLAMP, 0)
-                   | MASK(NV097_SET_TEXTURE_CONTROL0_MAX_LOD_CLAMP, 4095));
+  p = PushState(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage),
+                NV097_SET_TEXTURE_CONTROL0_ENABLE
+                    | MASK(NV097_SET_TEXTURE_CONTROL0_ALPHA_KILL_ENABLE, false)
+                    | MASK(NV097_SET_TEXTURE_CONTROL0_MIN_LOD_CLAMP, 0)
+                    | MASK(NV097_SET_TEXTURE_CONTROL0_MAX_LOD_CLAMP, 4095));
+
+  p = PushState(p, NV097_SET_SHADER_STAGE_PROGRAM,
+                MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, STAGE_2D_PROJECTIVE));
+
+  pb_end(p);
+}
+
+// Defined with the PrimitiveBatchV vertex layouts.
+static void BindBlitVertexArrays(const uint8_t* vertices);
+static void DrawBatchArrays(uint32_t num_vertices);
+
+static void ApplyBlendMode(GPU_bool use_blending, const GPU_BlendMode& blend_mode) {
+  // The NV097 blend factors and equations share their values with the GL enums used by
+  // GPU_BlendMode. The NV2A does not support a separate alpha blend function.
+  auto p = pb_begin();
+  p = PushState(p, NV097_SET_BLEND_ENABLE, use_blending);
+  if (use_blending) {
+    p = PushState(p, NV097_SET_BLEND_EQUATION, blend_mode.color_equation);
+    p = PushState(p, NV097_SET_BLEND_FUNC_SFACTOR, blend_mode.source_color);
+    p = PushState(p, NV097_SET_BLEND_FUNC_DFACTOR, blend_mode.dest_color);
+  }
+  pb_end(p);
+}
+
+static void ApplyShapeBlendMode(GPU_Renderer* renderer) {
+  auto context_target = renderer->current_context_target;
+  if (!context_target || !context_target->context) {
+    return;
+  }
+  ApplyBlendMode(context_target->context->shapes_use_blending,
+                 context_target->context->shapes_blend_mode);
+}
+
+struct BlitVertex {
+  float x, y;
+  float u, v;
+};
+
+// Blits are accumulated on the CPU for as long as the texture and blend state stay the same and
+// are emitted as a single QUADS primitive.
+static constexpr uint32_t kMaxBatchedBlitVertices = 4 * 512;
+
+struct BlitBatch {
+  GPU_Image* image;
+  GPU_Target* target;
+  uint32_t num_vertices;
+  alignas(16) BlitVertex vertices[kMaxBatchedBlitVertices];
+};
+
+static BlitBatch blit_batch;
+
+static bool IsBlitBatchCompatible(const GPU_Image* image, const GPU_Target* target) {
+  if (blit_batch.target != target) {
+    return false;
+  }
 
-  p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM,
-               MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, STAGE_2D_PROJECTIVE));
+  auto batch_image = blit_batch.image;
+  if (batch_image == image) {
+    return true;
+  }
+
+  auto batch_data = (const PBKitImageData*)batch_image->data;
+  auto image_data = (const PBKitImageData*)image->data;
+  return batch_data->TextureData() == image_data->TextureData() && batch_data->format == image_data->format
+         && batch_data->palette == image_data->palette
+         && batch_image->texture_w == image->texture_w && batch_image->texture_h == image->texture_h
+         && batch_image->filter_mode == image->filter_mode
+         && batch_image->wrap_mode_x == image->wrap_mode_x
+         && batch_image->wrap_mode_y == image->wrap_mode_y
+         && batch_image->use_blending == image->use_blending
+         && !memcmp(&batch_image->blend_mode, &image->blend_mode, sizeof(image->blend_mode));
+}
+
+static void FlushBlitBatch() {
+  if (!blit_batch.num_vertices) {
+    return;
+  }
+
+  BindTarget(blit_batch.target);
+  BindTexture(blit_batch.image);
+  ApplyBlendMode(blit_batch.image->use_blending, blit_batch.image->blend_mode);
+
+  uint32_t byte_length = blit_batch.num_vertices * sizeof(BlitVertex);
+  auto ring_vertices = AllocateVertexRingSpace(byte_length);
+  if (ring_vertices) {
+    memcpy(ring_vertices, blit_batch.vertices, byte_length);
+    // Flush the write-combining buffers before the GPU fetches the vertices.
+    _mm_sfence();
+
+    BindBlitVertexArrays(ring_vertices);
+  }
+
+  auto p = pb_begin();
+  p = PushState(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_QUADS);
+  pb_end(p);
+
+  if (ring_vertices) {
+    DrawBatchArrays(blit_batch.num_vertices);
+  }
+
+  // If the ring is unavailable the vertices are sent in immediate mode. Each vertex takes 8 words,
+  // keep each block within pbkit's 128 word limit.
+  static constexpr uint32_t kVerticesPerBlock = 16;
+  const BlitVertex* vertex = blit_batch.vertices;
+  uint32_t num_immediate_vertices = ring_vertices ? 0 : blit_batch.num_vertices;
+  for (uint32_t i = 0; i < num_immediate_vertices; i += kVerticesPerBlock) {
+    uint32_t count = num_immediate_vertices - i;
+    if (count > kVerticesPerBlock) {
+      count = kVerticesPerBlock;
+    }
+
+    p = pb_begin();
+    for (uint32_t v = 0; v < count; ++v, ++vertex) {
+      p = pb_push2f(p, NV097_SET_TEXCOORD0_2F, vertex->u, vertex->v);
+      p = pb_push4f(p, NV097_SET_VERTEX4F, vertex->x, vertex->y, 0, 1);
+    }
+    pb_end(p);
+  }
 
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
   pb_end(p);
+
+  blit_batch.num_vertices = 0;
+}
+
+static void FlushBlitBatchIfUsing(const GPU_Image* image) {
+  if (blit_batch.num_vertices && blit_batch.image == image) {
+    FlushBlitBatch();
+  }
+}
+
+// Returns space for `count` vertices in the batch drawing `image` into `target`, flushing the
+// pending batch first if it uses different state.
+static BlitVertex* ReserveBlitVertices(GPU_Image* image, GPU_Target* target, uint32_t count) {
+  if (blit_batch.num_vertices
+      && (!IsBlitBatchCompatible(image, target)
+          || blit_batch.num_vertices + count > kMaxBatchedBlitVertices)) {
+    FlushBlitBatch();
+  }
+
+  blit_batch.image = image;
+  blit_batch.target = target;
+  auto ret = blit_batch.vertices + blit_batch.num_vertices;
+  blit_batch.num_vertices += count;
+  return ret;
+}
+
+// Writes the four corners of the quad spanning (left, top) - (right, bottom), rotated about the
+// origin and translated to (x, y), in clockwise order starting from the top left.
+static void TransformBlitCorners(BlitVertex* vertices,
+                                 float x,
+                                 float y,
+                                 float left,
+                                 float top,
+                                 float right,
+                                 float bottom,
+                                 const UVRect& tex_coords,
+                                 float cos_a,
+                                 float sin_a) {
+#ifdef __SSE__
+  // Each register holds one component of all four corners.
+  __m128 corner_x = _mm_setr_ps(left, right, right, left);
+  __m128 corner_y = _mm_setr_ps(top, top, bottom, bottom);
+  __m128 cos_v = _mm_set1_ps(cos_a);
+  __m128 sin_v = _mm_set1_ps(sin_a);
+
+  __m128 out_x = _mm_add_ps(_mm_set1_ps(x),
+                            _mm_sub_ps(_mm_mul_ps(corner_x, cos_v), _mm_mul_ps(corner_y, sin_v)));
+  __m128 out_y = _mm_add_ps(_mm_set1_ps(y),
+                            _mm_add_ps(_mm_mul_ps(corner_x, sin_v), _mm_mul_ps(corner_y, cos_v)));
+  __m128 u = _mm_setr_ps(tex_coords.left, tex_coords.right, tex_coords.right, tex_coords.left);
+  __m128 v = _mm_setr_ps(tex_coords.top, tex_coords.top, tex_coords.bottom, tex_coords.bottom);
+
+  // Transpose into x, y, u, v per vertex.
+  __m128 xy_01 = _mm_unpacklo_ps(out_x, out_y);
+  __m128 xy_23 = _mm_unpackhi_ps(out_x, out_y);
+  __m128 uv_01 = _mm_unpacklo_ps(u, v);
+  __m128 uv_23 = _mm_unpackhi_ps(u, v);
+
+  auto out = reinterpret_cast<float*>(vertices);
+  _mm_store_ps(out, _mm_movelh_ps(xy_01, uv_01));
+  _mm_store_ps(out + 4, _mm_movehl_ps(uv_01, xy_01));
+  _mm_store_ps(out + 8, _mm_movelh_ps(xy_23, uv_23));
+  _mm_store_ps(out + 12, _mm_movehl_ps(uv_23, xy_23));
+#else
+  auto vtx = [&](float cx, float cy, float u, float v) {
+    *vertices++ = { x + cx * cos_a - cy * sin_a, y + cx * sin_a + cy * cos_a, u, v };
+  };
+
+  vtx(left, top, tex_coords.left, tex_coords.top);
+  vtx(right, top, tex_coords.right, tex_coords.top);
+  vtx(right, bottom, tex_coords.right, tex_coords.bottom);
+  vtx(left, bottom, tex_coords.left, tex_coords.bottom);
+#endif
 }
 
 // clang-format off
@@ -943,8 +2203,6 @@ static void SDLCALL BlitTransformX(GPU_Renderer* renderer,
     src_rect = &fallback_surface_rect;
   }
 
-  BindTexture(image);
-
   if (image->snap_mode == GPU_SNAP_POSITION
       || image->snap_mode == GPU_SNAP_POSITION_AND_DIMENSIONS) {
     // Avoid rounding errors in texture sampling by insisting on integral pixel positions
@@ -952,33 +2210,275 @@ static void SDLCALL BlitTransformX(GPU_Renderer* renderer,
     y = floorf(y);
   }
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
-  p = pb_push1(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  if (!MakeImageResident(image)) {
+    return;
+  }
 
-  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_QUADS);
+  auto image_data = (PBKitImageData*)image->data;
+  auto tex_coords = image_data->MakeTexCoords(src_rect, image);
 
-  x -= pivot_x;
-  y -= pivot_y;
+  auto vertex = ReserveBlitVertices(image, target, 4);
 
-  auto vtx = [&p](float x, float y, float u, float v) {
-    //    p = pb_push1(p, NV097_SET_DIFFUSE_COLOR4I, 0xFFFF00FF);
-    p = pb_push2f(p, NV097_SET_TEXCOORD0_2F, u, v);
-    p = pb_push4f(p, NV097_SET_VERTEX4F, x, y, 0, 1);
+  if (degrees == 0.0f && scaleX == 1.0f && scaleY == 1.0f) {
+    x -= pivot_x;
+    y -= pivot_y;
+
+    auto vtx = [&vertex](float x, float y, float u, float v) {
+      *vertex++ = { x, y, u, v };
+    };
+
+    vtx(x, y, tex_coords.left, tex_coords.top);
+    vtx(x + src_rect->w, y, tex_coords.right, tex_coords.top);
+    vtx(x + src_rect->w, y + src_rect->h, tex_coords.right, tex_coords.bottom);
+    vtx(x, y + src_rect->h, tex_coords.left, tex_coords.bottom);
+    return;
+  }
+
+  float radians = degrees * (3.14159265f / 180.0f);
+  float left = -pivot_x * scaleX;
+  float top = -pivot_y * scaleY;
+  float right = (src_rect->w - pivot_x) * scaleX;
+  float bottom = (src_rect->h - pivot_y) * scaleY;
+
+  // Mirroring along a single axis reverses the winding order, swap the quad around so it is not
+  // culled.
+  if ((scaleX < 0.0f) != (scaleY < 0.0f)) {
+    std::swap(left, right);
+    std::swap(tex_coords.left, tex_coords.right);
+  }
+
+  TransformBlitCorners(vertex, x, y, left, top, right, bottom, tex_coords, cosf(radians),
+                       sinf(radians));
+}
+
+// Describes the interleaved vertex layout passed to PrimitiveBatchV and the packed layout sent to
+// the GPU. Positions and texture coordinates are sent as floats and colors as a single UB_OGL
+// word, so each vertex takes between 2 and 6 words.
+//
+// INLINE_ARRAY vertices are read in ascending attribute order, so the packed layout is position,
+// color, texture coordinates. The vertex arrays used with the ring buffer point at the same
+// offsets, which keeps both paths identical.
+static_assert(NV2A_VERTEX_ATTR_POSITION < NV2A_VERTEX_ATTR_DIFFUSE
+                  && NV2A_VERTEX_ATTR_DIFFUSE < NV2A_VERTEX_ATTR_TEXTURE0,
+              "Packed batch vertices must follow the attribute order of INLINE_ARRAY");
+
+struct BatchVertexLayout {
+  uint32_t position_size;
+  bool has_texcoords;
+  uint32_t color_size;
+  bool color_is_bytes;
+
+  // Offsets and stride of the source data, in bytes.
+  uint32_t source_stride;
+  uint32_t source_texcoord_offset;
+  uint32_t source_color_offset;
+
+  // Offsets in words within each packed vertex, and the number of words in it.
+  uint32_t packed_color_offset;
+  uint32_t packed_texcoord_offset;
+  uint32_t packed_stride;
+};
+
+static bool GetBatchVertexLayout(GPU_BatchFlagEnum flags, BatchVertexLayout* layout) {
+  memset(layout, 0, sizeof(*layout));
+
+  if (flags & GPU_BATCH_XYZ) {
+    layout->position_size = 3;
+  } else if (flags & GPU_BATCH_XY) {
+    layout->position_size = 2;
+  } else {
+    return false;
+  }
+
+  uint32_t num_floats = layout->position_size;
+  if (flags & GPU_BATCH_ST) {
+    layout->has_texcoords = true;
+    layout->source_texcoord_offset = num_floats * sizeof(float);
+    num_floats += 2;
+  }
+
+  layout->source_color_offset = num_floats * sizeof(float);
+  if (flags & GPU_BATCH_RGBA) {
+    layout->color_size = 4;
+    num_floats += 4;
+  } else if (flags & GPU_BATCH_RGB) {
+    layout->color_size = 3;
+    num_floats += 3;
+  } else if (flags & GPU_BATCH_RGBA8) {
+    layout->color_size = 4;
+    layout->color_is_bytes = true;
+  } else if (flags & GPU_BATCH_RGB8) {
+    layout->color_size = 3;
+    layout->color_is_bytes = true;
+  }
+
+  layout->source_stride = num_floats * sizeof(float);
+  if (layout->color_is_bytes) {
+    layout->source_stride += layout->color_size;
+  }
+
+  layout->packed_color_offset = layout->position_size;
+  layout->packed_texcoord_offset = layout->packed_color_offset + (layout->color_size ? 1 : 0);
+  layout->packed_stride = layout->packed_texcoord_offset + (layout->has_texcoords ? 2 : 0);
+  return true;
+}
+
+static inline uint32_t PackColorComponent(float value) {
+  if (value <= 0.0f) {
+    return 0;
+  }
+  if (value >= 1.0f) {
+    return 0xFF;
+  }
+  return (uint32_t)(value * 255.0f + 0.5f);
+}
+
+// Converts `num_vertices` vertices starting at `source` to the packed layout at `dest`. Texture
+// coordinates are mapped from image space into the texture.
+static uint32_t* PackBatchVertices(uint32_t* dest,
+                                   const uint8_t* source,
+                                   uint32_t num_vertices,
+                                   const BatchVertexLayout& layout,
+                                   const TexCoordMapping& texcoord_mapping) {
+  for (uint32_t i = 0; i < num_vertices; ++i, source += layout.source_stride) {
+    memcpy(dest, source, layout.position_size * sizeof(float));
+    dest += layout.position_size;
+
+    if (layout.color_size) {
+      uint32_t r, g, b, a = 0xFF;
+      const uint8_t* color = source + layout.source_color_offset;
+      if (layout.color_is_bytes) {
+        r = color[0];
+        g = color[1];
+        b = color[2];
+        if (layout.color_size == 4) {
+          a = color[3];
+        }
+      } else {
+        float rgba[4];
+        memcpy(rgba, color, layout.color_size * sizeof(float));
+        r = PackColorComponent(rgba[0]);
+        g = PackColorComponent(rgba[1]);
+        b = PackColorComponent(rgba[2]);
+        if (layout.color_size == 4) {
+          a = PackColorComponent(rgba[3]);
+        }
+      }
+      *dest++ = r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    if (layout.has_texcoords) {
+      float st[2];
+      memcpy(st, source + layout.source_texcoord_offset, sizeof(st));
+      *((float*)dest++) = st[0] * texcoord_mapping.scale_u + texcoord_mapping.offset_u;
+      *((float*)dest++) = st[1] * texcoord_mapping.scale_v + texcoord_mapping.offset_v;
+    }
+  }
+  return dest;
+}
+
+// Sets up the vertex array formats for `layout`, disabling all other attributes.
+static void SetBatchVertexFormat(const BatchVertexLayout& layout) {
+  // A float format with 0 components disables the attribute.
+  uint32_t formats[16];
+  for (auto& format : formats) {
+    format = MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F);
+  }
+
+  uint32_t stride = layout.packed_stride * 4;
+  auto set_format = [&formats, stride](uint32_t attribute, uint32_t type, uint32_t size) {
+    formats[attribute] = MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE, type)
+                         | MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_SIZE, size)
+                         | MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_STRIDE, stride);
   };
 
-  auto image_data = (PBKitImageData*)image->data;
-  auto tex_coords = image_data->MakeTexCoords(src_rect, image);
+  set_format(NV2A_VERTEX_ATTR_POSITION, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F,
+             layout.position_size);
+  if (layout.has_texcoords) {
+    set_format(NV2A_VERTEX_ATTR_TEXTURE0, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F, 2);
+  }
+  if (layout.color_size) {
+    set_format(NV2A_VERTEX_ATTR_DIFFUSE, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_OGL, 4);
+  }
 
-  vtx(x, y, tex_coords.left, tex_coords.top);
-  vtx(x + src_rect->w, y, tex_coords.right, tex_coords.top);
-  vtx(x + src_rect->w, y + src_rect->h, tex_coords.right, tex_coords.bottom);
-  vtx(x, y + src_rect->h, tex_coords.left, tex_coords.bottom);
+  auto p = pb_begin();
+  p = PushStateN(p, NV097_SET_VERTEX_DATA_ARRAY_FORMAT, formats, 16);
+  pb_end(p);
+}
 
-  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
+// Points the vertex arrays enabled by `layout` at packed vertices in contiguous memory.
+static void SetBatchVertexArrays(const BatchVertexLayout& layout, const uint8_t* vertices) {
+  auto offset = (uint32_t)(intptr_t)vertices & 0x03ffffff;
+
+  auto p = pb_begin();
+  p = PushState(p, NV097_SET_VERTEX_DATA_ARRAY_OFFSET + NV2A_VERTEX_ATTR_POSITION * 4, offset);
+  if (layout.color_size) {
+    p = PushState(p, NV097_SET_VERTEX_DATA_ARRAY_OFFSET + NV2A_VERTEX_ATTR_DIFFUSE * 4,
+                  offset + layout.packed_color_offset * 4);
+  }
+  if (layout.has_texcoords) {
+    p = PushState(p, NV097_SET_VERTEX_DATA_ARRAY_OFFSET + NV2A_VERTEX_ATTR_TEXTURE0 * 4,
+                  offset + layout.packed_texcoord_offset * 4);
+  }
   pb_end(p);
 }
 
+// Points the vertex arrays at blit vertices in contiguous memory.
+static void BindBlitVertexArrays(const uint8_t* vertices) {
+  BatchVertexLayout layout;
+  GetBatchVertexLayout(GPU_BATCH_XY | GPU_BATCH_ST, &layout);
+  SetBatchVertexFormat(layout);
+  SetBatchVertexArrays(layout, vertices);
+}
+
+// Emits `num_indices` indices into the currently bound vertex arrays. Pairs of indices are packed
+// into a single ARRAY_ELEMENT16 word, an odd trailing index is sent via ARRAY_ELEMENT32.
+static void DrawBatchIndices(const unsigned short* indices, uint32_t num_indices) {
+  static constexpr uint32_t kMaxPairsPerBlock = 127;
+
+  uint32_t num_pairs = num_indices >> 1;
+  while (num_pairs) {
+    uint32_t count = num_pairs > kMaxPairsPerBlock ? kMaxPairsPerBlock : num_pairs;
+    num_pairs -= count;
+
+    auto p = pb_begin();
+    pb_push_to(SUBCH_3D, p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_ARRAY_ELEMENT16), count);
+    for (uint32_t i = 0; i < count; ++i, indices += 2) {
+      *(p++) = indices[0] | (indices[1] << 16);
+    }
+    pb_end(p);
+  }
+
+  if (num_indices & 1) {
+    auto p = pb_begin();
+    p = pb_push1(p, NV097_ARRAY_ELEMENT32, *indices);
+    pb_end(p);
+  }
+}
+
+// Draws `num_vertices` consecutive vertices from the currently bound vertex arrays.
+static void DrawBatchArrays(uint32_t num_vertices) {
+  // Each DRAW_ARRAYS word covers up to 256 vertices.
+  static constexpr uint32_t kMaxRunsPerBlock = 127;
+
+  uint32_t start = 0;
+  while (start < num_vertices) {
+    auto p = pb_begin();
+    auto header = p++;
+    uint32_t runs = 0;
+    for (; runs < kMaxRunsPerBlock && start < num_vertices; ++runs) {
+      uint32_t count = num_vertices - start;
+      if (count > 256) {
+        count = 256;
+      }
+      *(p++) = MASK(NV097_DRAW_ARRAYS_COUNT, count - 1) | MASK(NV097_DRAW_ARRAYS_START_INDEX, start);
+      start += count;
+    }
+    pb_push_to(SUBCH_3D, header, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_DRAW_ARRAYS), runs);
+    pb_end(p);
+  }
+}
+
 static void SDLCALL PrimitiveBatchV(GPU_Renderer* renderer,
                                     GPU_Image* image,
                                     GPU_Target* target,
@@ -988,11 +2488,211 @@ static void SDLCALL PrimitiveBatchV(GPU_Renderer* renderer,
                                     unsigned int num_indices,
                                     unsigned short* indices,
                                     GPU_BatchFlagEnum flags) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  if (num_vertices == 0) {
+    return;
+  }
+  if (target == NULL) {
+    GPU_PushErrorCode("GPU_PrimitiveBatchV", GPU_ERROR_NULL_ARGUMENT, "target");
+    return;
+  }
+  if (values == NULL) {
+    GPU_PushErrorCode("GPU_PrimitiveBatchV", GPU_ERROR_NULL_ARGUMENT, "values");
+    return;
+  }
+  if (primitive_type > GPU_TRIANGLE_FAN) {
+    GPU_PushErrorCode("GPU_PrimitiveBatchV", GPU_ERROR_USER_ERROR, "Invalid primitive type");
+    return;
+  }
+
+  BatchVertexLayout layout;
+  if (!GetBatchVertexLayout(flags, &layout)) {
+    GPU_PushErrorCode("GPU_PrimitiveBatchV", GPU_ERROR_USER_ERROR, "Missing position flag");
+    return;
+  }
+
+  if (indices) {
+    unsigned short max_index = 0;
+    for (uint32_t i = 0; i < num_indices; ++i) {
+      max_index = indices[i] > max_index ? indices[i] : max_index;
+    }
+    if (max_index >= num_vertices) {
+      GPU_PushErrorCode("GPU_PrimitiveBatchV", GPU_ERROR_USER_ERROR,
+                        "Index %u is out of range for %u vertices", max_index, num_vertices);
+      return;
+    }
+  }
+
+  if (image && !MakeImageResident(image)) {
+    return;
+  }
+
+  renderer->impl->FlushBlitBuffer(renderer);
+  BindTarget(target);
+
+  TexCoordMapping texcoord_mapping = { 1.0f, 1.0f, 0.0f, 0.0f };
+  SDL_Color color = { 0xFF, 0xFF, 0xFF, 0xFF };
+  if (image) {
+    BindTexture(image);
+    ApplyBlendMode(image->use_blending, image->blend_mode);
+    texcoord_mapping = ((PBKitImageData*)image->data)->MakeTexCoordMapping(image);
+    color = image->color;
+  } else {
+    UnbindTexture();
+    ApplyShapeBlendMode(renderer);
+    if (target->use_color) {
+      color = target->color;
+    }
+  }
+
+  SetBatchVertexFormat(layout);
+
+  auto vertex_data = static_cast<const uint8_t*>(values);
+
+  // Vertices are packed once into the ring and fetched by the GPU. Shared vertices are referenced
+  // by index rather than duplicated.
+  auto ring_vertices = AllocateVertexRingSpace(num_vertices * layout.packed_stride * 4);
+  if (ring_vertices) {
+    PackBatchVertices(reinterpret_cast<uint32_t*>(ring_vertices), vertex_data, num_vertices,
+                      layout, texcoord_mapping);
+    // Flush the write-combining buffers before the GPU fetches the vertices.
+    _mm_sfence();
+    SetBatchVertexArrays(layout, ring_vertices);
+  }
+
+  auto p = pb_begin();
+  p = PushState(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  if (!layout.color_size) {
+    // The diffuse attribute is disabled, so the last value set is used for every vertex.
+    p = pb_push1(p, NV097_SET_DIFFUSE_COLOR4I,
+                 color.r + (color.g << 8) + (color.b << 16) + (color.a << 24));
+  }
+  // The GPU_PrimitiveEnum values match GL, which are one less than the NV097 equivalents.
+  p = pb_push1(p, NV097_SET_BEGIN_END, primitive_type + 1);
+  pb_end(p);
+
+  // If the ring is unavailable the vertices are sent inline. Each block holds a single INLINE_ARRAY
+  // packet of whole vertices, keeping it within pbkit's 128 word limit.
+  const uint32_t vertices_per_block = 127 / layout.packed_stride;
+
+  auto emit_vertices = [&](const uint8_t* source, uint32_t count) {
+    p = pb_begin();
+    pb_push_to(SUBCH_3D, p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY),
+               count * layout.packed_stride);
+    p = PackBatchVertices(p, source, count, layout, texcoord_mapping);
+    pb_end(p);
+  };
+
+  if (ring_vertices) {
+    if (indices) {
+      DrawBatchIndices(indices, num_indices);
+    } else {
+      DrawBatchArrays(num_vertices);
+    }
+  } else if (indices) {
+    for (uint32_t i = 0; i < num_indices;) {
+      uint32_t count = num_indices - i;
+      if (count > vertices_per_block) {
+        count = vertices_per_block;
+      }
+
+      p = pb_begin();
+      pb_push_to(SUBCH_3D, p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY),
+                 count * layout.packed_stride);
+      for (uint32_t end = i + count; i < end; ++i) {
+        p = PackBatchVertices(p, vertex_data + indices[i] * layout.source_stride, 1, layout,
+                              texcoord_mapping);
+      }
+      pb_end(p);
+    }
+  } else {
+    for (uint32_t i = 0; i < num_vertices; i += vertices_per_block) {
+      uint32_t count = num_vertices - i;
+      if (count > vertices_per_block) {
+        count = vertices_per_block;
+      }
+      emit_vertices(vertex_data + i * layout.source_stride, count);
+    }
+  }
+
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
+  pb_end(p);
 }
 
-static void SDLCALL GenerateMipmaps(GPU_Renderer* renderer, GPU_Image* image) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+// Builds a full mip chain from the current contents of the image's texture. The chain is not kept
+// up to date by later updates, which must be followed by another call.
+static void SDLCALL GenerateMipmaps(GPU_Renderer* renderer, GPU_Image* image) {
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_GenerateMipmaps", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  auto packing = GetTexelPacking(image_data->format);
+  if (image_data->linear || IsCompressedFormat(image_data->format)
+      || packing == TexelPacking::kI8) {
+    GPU_PushErrorCode("GPU_GenerateMipmaps", GPU_ERROR_USER_ERROR,
+                      "Linear, compressed and paletted images cannot have generated mipmaps");
+    return;
+  }
+
+  if (!MakeImageResident(image)) {
+    return;
+  }
+
+  // Blits already batched were made without mipmaps, and queued updates belong in level 0.
+  FlushBlitBatchIfUsing(image);
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  CompleteUploads(owner);
+  // The cached texels have no mipmaps and may be shorter than the chain.
+  owner->DropCachedTexels();
+  if (image->target) {
+    // Level 0 is read back once everything drawn into it has been rendered.
+    renderer->impl->FlushBlitBuffer(renderer);
+    WaitForFence(InsertFence());
+  }
+
+  uint32_t width = image->texture_w;
+  uint32_t height = image->texture_h;
+  uint32_t levels =
+      (image_data->size_u > image_data->size_v ? image_data->size_u : image_data->size_v) + 1;
+  uint32_t level_size = width * height * image->bytes_per_pixel;
+  uint32_t chain_size = MipChainSize(width, height, levels, image->bytes_per_pixel);
+
+  // Texture memory is write-combined and slow to read, so level 0 is read once and the chain is
+  // built in cached memory.
+  auto chain = (uint8_t*)SDL_malloc(chain_size);
+  if (!chain) {
+    GPU_PushErrorCode("GPU_GenerateMipmaps", GPU_ERROR_BACKEND_ERROR,
+                      "Failed to allocate %u bytes for the mip chain", chain_size);
+    return;
+  }
+  memcpy(chain, owner->data, level_size);
+  DownsampleMipChain(chain, width, height, levels, packing);
+
+  if (owner->byte_length < chain_size) {
+    // The data pointer is only replaced on success, so the image is left as it was on failure.
+    uint8_t* old_data = owner->data;
+    if (!AllocateTextureMemory(chain_size, &owner->data)) {
+      SDL_free(chain);
+      GPU_PushErrorCode("GPU_GenerateMipmaps", GPU_ERROR_BACKEND_ERROR,
+                        "Failed to allocate %u bytes of texture memory", chain_size);
+      return;
+    }
+    // Draws still in flight keep sampling the old memory until the GPU has passed them.
+    FreeTextureMemory(old_data);
+    owner->byte_length = chain_size;
+    memcpy(owner->data, chain, chain_size);
+  } else {
+    memcpy(owner->data + level_size, chain + level_size, chain_size - level_size);
+  }
+  SDL_free(chain);
+  _mm_sfence();
+
+  owner->mip_levels = levels;
+  image_data->mip_levels = levels;
+  image->has_mipmaps = GPU_TRUE;
 }
 
 static GPU_Rect SDLCALL SetClip(
@@ -1013,17 +2713,32 @@ static SDL_Color SDLCALL GetPixel(GPU_Renderer* renderer,
   return {};
 }
 
+// Sampling state is applied when the image is bound. Padding texels are only written on update, so
+// the modes should be set before the image contents.
 static void SDLCALL SetImageFilter(GPU_Renderer* renderer,
                                    GPU_Image* image,
                                    GPU_FilterEnum filter) {
-  // TODO: Implement me.
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_SetImageFilter", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+
+  FlushBlitBatchIfUsing(image);
+  image->filter_mode = filter;
 }
 
 static void SDLCALL SetWrapMode(GPU_Renderer* renderer,
                                 GPU_Image* image,
                                 GPU_WrapEnum wrap_mode_x,
                                 GPU_WrapEnum wrap_mode_y) {
-  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+  if (image == nullptr) {
+    GPU_PushErrorCode("GPU_SetWrapMode", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+
+  FlushBlitBatchIfUsing(image);
+  image->wrap_mode_x = wrap_mode_x;
+  image->wrap_mode_y = wrap_mode_y;
 }
 
 static GPU_TextureHandle SDLCALL GetTextureHandle(GPU_Renderer* renderer, GPU_Image* image) {
@@ -1033,21 +2748,223 @@ static GPU_TextureHandle SDLCALL GetTextureHandle(GPU_Renderer* renderer, GPU_Im
 
 static void SDLCALL ClearRGBA(
     GPU_Renderer* renderer, GPU_Target* target, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
-  PBKITSDLGPU_ASSERT(target->context);
-  auto context = static_cast<PBKitSDLContext*>(target->context->data);
-  pb_fill(0, 0, context->width, context->height, (a << 24) | (r << 16) | (g << 8) | b);
+  renderer->impl->FlushBlitBuffer(renderer);
+  BindTarget(target);
+
+  auto image = target->image;
+  if (!image) {
+    if (!target->context) {
+      GPU_PushErrorCode("GPU_ClearRGBA", GPU_ERROR_USER_ERROR, "The target's image has been freed");
+      return;
+    }
+    auto context = static_cast<PBKitSDLContext*>(target->context->data);
+    pb_fill(0, 0, context->width, context->height, (a << 24) | (r << 16) | (g << 8) | b);
+    return;
+  }
+
+  // The clear value is in the format of the surface.
+  uint32_t color = (a << 24) | (r << 16) | (g << 8) | b;
+  if (GetTexelPacking(((PBKitImageData*)image->data)->format) == TexelPacking::kR5G6B5) {
+    color = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+  }
+  pb_fill(0, 0, image->w, image->h, color);
+}
+
+static void SDLCALL FlushBlitBuffer(GPU_Renderer* renderer) { FlushBlitBatch(); }
+
+// Returns true for the uncompressed formats a texture container may hold: swizzled 32 bit texels
+// in any of the channel orders the GPU samples.
+static bool IsContainerTexelFormat(uint32_t format) {
+  switch (format) {
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8B8G8R8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R8G8B8A8:
+  case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_B8G8R8A8:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static GPU_Image* LoadTextureContainer(GPU_Renderer* renderer, SDL_RWops* rwops) {
+  PBKitTextureContainerHeader header;
+  if (SDL_RWread(rwops, &header, sizeof(header), 1) != 1) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Failed to read header");
+    return nullptr;
+  }
+
+  if (header.magic != PBKIT_TEXTURE_CONTAINER_MAGIC
+      || header.version != PBKIT_TEXTURE_CONTAINER_VERSION) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Not a version %d texture container", PBKIT_TEXTURE_CONTAINER_VERSION);
+    return nullptr;
+  }
+
+  bool compressed = IsCompressedFormat(header.format);
+  if (!compressed && !IsContainerTexelFormat(header.format)) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Unsupported texture format (0x%x)", header.format);
+    return nullptr;
+  }
+
+  // The texture must be the power of two CreateImage would have chosen for the content size.
+  uint32_t max_levels = (header.size_u > header.size_v ? header.size_u : header.size_v) + 1;
+  if (header.size_u > 12 || header.size_v > 12 || !header.width || !header.height
+      || header.width > (1 << header.size_u)
+      || header.height > (1 << header.size_v) || header.width * 2 <= (1 << header.size_u)
+      || header.height * 2 <= (1 << header.size_v) || !header.mip_count
+      || header.mip_count > max_levels || header.bytes_per_pixel != (compressed ? 0 : 4)) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Unsupported texture dimensions or format");
+    return nullptr;
+  }
+
+  // Every declared level must be in the payload, and nothing else.
+  uint32_t chain_size =
+      compressed ? CompressedImageSize(header.format, header.size_u, header.size_v, header.mip_count)
+                 : MipChainSize(1 << header.size_u, 1 << header.size_v, header.mip_count,
+                                header.bytes_per_pixel);
+  if (header.payload_size != chain_size) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Payload size %u does not match the %u bytes of the mip chain",
+                      header.payload_size, chain_size);
+    return nullptr;
+  }
+
+  auto image = CreateUninitializedImage(renderer, header.width, header.height, GPU_FORMAT_RGBA);
+  if (!image) {
+    return nullptr;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  image_data->format = header.format;
+  if (!TryAllocateImageStorage(image, header.payload_size)) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Failed to allocate %u bytes of texture memory", header.payload_size);
+    FreeImage(renderer, image);
+    return nullptr;
+  }
+  image_data->mip_levels = header.mip_count;
+  image->has_mipmaps = header.mip_count > 1 ? GPU_TRUE : GPU_FALSE;
+
+  // The payload is already in the layout the GPU expects, so it is read straight into texture
+  // memory.
+  if (SDL_RWread(rwops, image_data->data, header.payload_size, 1) != 1) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_DATA_ERROR,
+                      "Failed to read payload");
+    FreeImage(renderer, image);
+    return nullptr;
+  }
+
+  return image;
+}
+
+// Column-major matrix applied to vertex positions by the transform program.
+static float transform_matrix[16];
+static bool transform_enabled = false;
+
+static bool IsIdentityMatrix(const float* matrix) {
+  for (uint32_t i = 0; i < 16; ++i) {
+    if (matrix[i] != ((i % 5) ? 0.0f : 1.0f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void SetTransform(const float* matrix) {
+  if (!matrix || IsIdentityMatrix(matrix)) {
+    if (transform_enabled) {
+      FlushBlitBatch();
+      UsePassthroughVertexShader();
+      transform_enabled = false;
+    }
+    return;
+  }
+
+  if (transform_enabled && !memcmp(transform_matrix, matrix, sizeof(transform_matrix))) {
+    return;
+  }
+
+  // Pending blits were positioned with the previous transform.
+  FlushBlitBatch();
+  memcpy(transform_matrix, matrix, sizeof(transform_matrix));
+
+  // Each constant holds one row, so the column-major matrix is uploaded transposed.
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_TRANSFORM_CONSTANT_LOAD, kTransformMatrixConstant);
+  pb_push_to(SUBCH_3D, p++, NV097_SET_TRANSFORM_CONSTANT, 16);
+  for (uint32_t row = 0; row < 4; ++row) {
+    for (uint32_t column = 0; column < 4; ++column) {
+      *((float*)p++) = matrix[column * 4 + row];
+    }
+  }
+  pb_end(p);
+
+  UseTransformVertexShader();
+  transform_enabled = true;
 }
 
-static void SDLCALL FlushBlitBuffer(GPU_Renderer* renderer) {
-  //  PBKITSDLGPU_ASSERT(!"TODO: Implement me");
+// Frames that may be queued on the GPU at once, 0 to drain the GPU at every flip.
+static constexpr uint32_t kMaxFramesInFlight = 3;
+static uint32_t frames_in_flight = 0;
+static bool wait_for_vblank = true;
+// Fence after each of the most recent frames, indexed by frame number modulo frames_in_flight.
+static uint32_t frame_fences[kMaxFramesInFlight];
+static uint32_t frame_number = 0;
+
+static void SetFramePipelining(uint32_t max_frames_in_flight, bool vblank) {
+  // Frames already queued were counted against the previous limit.
+  if (frames_in_flight) {
+    WaitForFence(frame_fences[(frame_number + frames_in_flight - 1) % frames_in_flight]);
+  }
+  frames_in_flight =
+      max_frames_in_flight < kMaxFramesInFlight ? max_frames_in_flight : kMaxFramesInFlight;
+  wait_for_vblank = vblank;
+  memset(frame_fences, 0, sizeof(frame_fences));
 }
 
 static void SDLCALL Flip(GPU_Renderer* renderer, GPU_Target* target) {
   renderer->impl->FlushBlitBuffer(renderer);
+  BindBackBuffer(GetWindowContext(renderer));
+  // Uploads are swapped in between frames, after the last draw that samples the old contents.
+  ProcessUploads();
+  EndTextureFrame();
+
+  if (frames_in_flight) {
+    // pbkit shows the back buffer once the GPU reaches the swap, so the next frame is built while
+    // this one renders. Its queue of framebuffers only refuses the swap when every one is waiting
+    // to be shown.
+    while (pb_finished()) {
+      /* Not ready to swap yet */
+    }
+
+    // Block only once the GPU falls more than `frames_in_flight` frames behind.
+    uint32_t slot = frame_number++ % frames_in_flight;
+    WaitForFence(frame_fences[slot]);
+    frame_fences[slot] = InsertFence();
+
+    if (wait_for_vblank) {
+      pb_wait_for_vbl();
+    }
+    pb_target_back_buffer();
+    // pb_target_back_buffer writes the surface clip, format, pitch and offsets directly.
+    InvalidateState(NV097_SET_SURFACE_CLIP_HORIZONTAL, 6);
+
+    // The push buffer can only be rewound while the GPU is not reading it. Otherwise pbkit wraps
+    // it around once it reaches the end.
+    if (!pb_busy()) {
+      OnGPUIdle();
+      pb_reset();
+    }
+    return;
+  }
 
   while (pb_busy()) {
     /* Wait for completion... */
   }
+  OnGPUIdle();
 
   while (pb_finished()) {
     /* Not ready to swap yet */
@@ -1055,6 +2972,8 @@ static void SDLCALL Flip(GPU_Renderer* renderer, GPU_Target* target) {
 
   pb_wait_for_vbl();
   pb_target_back_buffer();
+  // pb_target_back_buffer writes the surface clip, format, pitch and offsets directly.
+  InvalidateState(NV097_SET_SURFACE_CLIP_HORIZONTAL, 6);
   pb_reset();
 }
 
@@ -1403,12 +3322,15 @@ static void SDLCALL Rectangle(GPU_Renderer* renderer,
                               float x2,
                               float y2,
                               SDL_Color color) {
+  renderer->impl->FlushBlitBuffer(renderer);
+  BindTarget(target);
   UnbindTexture();
+  ApplyShapeBlendMode(renderer);
   auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_LINE);
+  p = PushState(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_LINE);
   // Note: This shouldn't strictly be necessary, but at the moment xemu disallows different
   // fill modes for front and back.
-  p = pb_push1(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_LINE);
+  p = PushState(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_LINE);
 
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_QUADS);
 
@@ -1424,8 +3346,8 @@ static void SDLCALL Rectangle(GPU_Renderer* renderer,
 
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
 
-  p = pb_push1(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
-  p = pb_push1(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_FRONT_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
+  p = PushState(p, NV097_SET_BACK_POLYGON_MODE, NV097_SET_FRONT_POLYGON_MODE_V_FILL);
   pb_end(p);
 }
 
@@ -1436,7 +3358,10 @@ static void SDLCALL RectangleFilled(GPU_Renderer* renderer,
                                     float x2,
                                     float y2,
                                     SDL_Color color) {
+  renderer->impl->FlushBlitBuffer(renderer);
+  BindTarget(target);
   UnbindTexture();
+  ApplyShapeBlendMode(renderer);
   auto p = pb_begin();
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_QUADS);
 
@@ -1520,6 +3445,7 @@ static GPU_Renderer* CreateRenderer(GPU_RendererID request) {
   renderer->default_image_anchor_y = 0.5f;
 
   renderer->current_context_target = nullptr;
+  renderer->enabled_features = GPU_FEATURE_RENDER_TARGETS;
 
   renderer->impl = (GPU_RendererImpl*)SDL_malloc(sizeof(GPU_RendererImpl));
   memset(renderer->impl, 0, sizeof(GPU_RendererImpl));
@@ -1644,6 +3570,379 @@ int fopen_s(FILE** pFile, const char* filename, const char* mode) {
 }
 }  // extern "C"
 
+void PBKitSDLGPUInvalidateStateCache() { PbkitSdlGpu::InvalidateAllState(); }
+
+GPU_Image* PBKitSDLGPUCreateLinearImage(Uint16 w, Uint16 h, GPU_FormatEnum format) {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateLinearImage", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+    return nullptr;
+  }
+
+  auto result = PbkitSdlGpu::CreateUninitializedImage(renderer, w, h, format);
+  if (!result) {
+    return nullptr;
+  }
+
+  PbkitSdlGpu::AllocateLinearImageStorage(result);
+  return result;
+}
+
+GPU_Image* PBKitSDLGPUCreate16BitImage(Uint16 w,
+                                       Uint16 h,
+                                       PBKitSDLGPU16BitFormat format,
+                                       GPU_bool linear) {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPUCreate16BitImage", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+    return nullptr;
+  }
+
+  int texture_format;
+  switch (format) {
+  case PBKIT_SDL_GPU_R5G6B5:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_SZ_R5G6B5;
+    break;
+  case PBKIT_SDL_GPU_A1R5G5B5:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A1R5G5B5;
+    break;
+  case PBKIT_SDL_GPU_A4R4G4B4:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A4R4G4B4;
+    break;
+  default:
+    GPU_PushErrorCode("PBKitSDLGPUCreate16BitImage", GPU_ERROR_DATA_ERROR,
+                      "Unsupported 16 bit format (%d)", format);
+    return nullptr;
+  }
+
+  auto result =
+      PbkitSdlGpu::CreateUninitializedImage(renderer, w, h, GPU_FORMAT_RGBA, texture_format);
+  if (!result) {
+    return nullptr;
+  }
+
+  if (linear) {
+    PbkitSdlGpu::AllocateLinearImageStorage(result);
+  } else {
+    PbkitSdlGpu::AllocateImageStorage(result, 0);
+  }
+  return result;
+}
+
+GPU_Image* PBKitSDLGPUCreateTargetImage(Uint16 w, Uint16 h, GPU_bool linear) {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateTargetImage", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+    return nullptr;
+  }
+
+  auto result = PbkitSdlGpu::CreateUninitializedImage(renderer, w, h, GPU_FORMAT_RGBA,
+                                                      NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8);
+  if (!result) {
+    return nullptr;
+  }
+
+  if (linear) {
+    PbkitSdlGpu::AllocateLinearImageStorage(result);
+  } else {
+    PbkitSdlGpu::AllocateImageStorage(result, 0);
+  }
+  return result;
+}
+
+void PBKitSDLGPUSetImageDither(GPU_Image* image, GPU_bool dither) {
+  if (!image) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImageDither", GPU_ERROR_NULL_ARGUMENT, "image");
+    return;
+  }
+  ((PbkitSdlGpu::PBKitImageData*)image->data)->dither = dither;
+}
+
+PBKitSDLGPUPalette* PBKitSDLGPUCreatePalette(const SDL_Color* colors, int count) {
+  if (!colors && count > 0) {
+    GPU_PushErrorCode("PBKitSDLGPUCreatePalette", GPU_ERROR_NULL_ARGUMENT, "colors");
+    return nullptr;
+  }
+  return PbkitSdlGpu::CreatePalette(colors, count > 0 ? count : 0);
+}
+
+void PBKitSDLGPUFreePalette(PBKitSDLGPUPalette* palette) {
+  if (palette) {
+    PbkitSdlGpu::ReleasePalette(palette);
+  }
+}
+
+void PBKitSDLGPUUpdatePalette(PBKitSDLGPUPalette* palette,
+                              const SDL_Color* colors,
+                              int first,
+                              int count) {
+  if (!palette || !colors) {
+    GPU_PushErrorCode("PBKitSDLGPUUpdatePalette", GPU_ERROR_NULL_ARGUMENT,
+                      palette ? "colors" : "palette");
+    return;
+  }
+  if (first < 0 || count <= 0) {
+    return;
+  }
+
+  // Batched blits have not been bound yet and must keep the old colors.
+  PbkitSdlGpu::FlushBlitBatch();
+  PbkitSdlGpu::SetPaletteColors(palette, colors, first, count);
+}
+
+GPU_Image* PBKitSDLGPUCreatePalettedImage(Uint16 w, Uint16 h, PBKitSDLGPUPalette* palette) {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPUCreatePalettedImage", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+    return nullptr;
+  }
+  if (!palette) {
+    GPU_PushErrorCode("PBKitSDLGPUCreatePalettedImage", GPU_ERROR_NULL_ARGUMENT, "palette");
+    return nullptr;
+  }
+  return PbkitSdlGpu::CreatePalettedImage(renderer, w, h, palette);
+}
+
+PBKitSDLGPUPalette* PBKitSDLGPUGetImagePalette(GPU_Image* image) {
+  return image ? ((PbkitSdlGpu::PBKitImageData*)image->data)->palette : nullptr;
+}
+
+void PBKitSDLGPUSetImagePalette(GPU_Image* image, PBKitSDLGPUPalette* palette) {
+  if (!image || !palette) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImagePalette", GPU_ERROR_NULL_ARGUMENT,
+                      image ? "palette" : "image");
+    return;
+  }
+
+  auto image_data = (PbkitSdlGpu::PBKitImageData*)image->data;
+  if (!image_data->palette) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImagePalette", GPU_ERROR_USER_ERROR,
+                      "The image is not paletted");
+    return;
+  }
+  if (image_data->palette == palette) {
+    return;
+  }
+
+  PbkitSdlGpu::FlushBlitBatchIfUsing(image);
+  PbkitSdlGpu::RetainPalette(palette);
+  PbkitSdlGpu::ReleasePalette(image_data->palette);
+  image_data->palette = palette;
+}
+
+GPU_Image* PBKitSDLGPUCreateCompressedImage(Uint16 w,
+                                            Uint16 h,
+                                            PBKitSDLGPUCompressedFormat format,
+                                            const void* data,
+                                            Uint32 size,
+                                            Uint8 mip_levels) {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateCompressedImage", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+    return nullptr;
+  }
+  if (!data) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateCompressedImage", GPU_ERROR_NULL_ARGUMENT, "data");
+    return nullptr;
+  }
+
+  uint32_t texture_format;
+  switch (format) {
+  case PBKIT_SDL_GPU_COMPRESSED_DXT1:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5;
+    break;
+  case PBKIT_SDL_GPU_COMPRESSED_DXT3:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT23_A8R8G8B8;
+    break;
+  case PBKIT_SDL_GPU_COMPRESSED_DXT5:
+    texture_format = NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT45_A8R8G8B8;
+    break;
+  default:
+    GPU_PushErrorCode("PBKitSDLGPUCreateCompressedImage", GPU_ERROR_DATA_ERROR,
+                      "Unsupported compressed format (%d)", format);
+    return nullptr;
+  }
+
+  auto size_u = PbkitSdlGpu::bsf((int)PbkitSdlGpu::getNearestPowerOf2(w));
+  auto size_v = PbkitSdlGpu::bsf((int)PbkitSdlGpu::getNearestPowerOf2(h));
+  uint32_t max_levels = (size_u > size_v ? size_u : size_v) + 1;
+  mip_levels = mip_levels ? mip_levels : 1;
+  uint32_t byte_length =
+      PbkitSdlGpu::CompressedImageSize(texture_format, size_u, size_v, mip_levels);
+  if (mip_levels > max_levels || size < byte_length) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateCompressedImage", GPU_ERROR_DATA_ERROR,
+                      "%u bytes do not hold %d levels of a %dx%d texture", size, mip_levels,
+                      1 << size_u, 1 << size_v);
+    return nullptr;
+  }
+
+  auto result = PbkitSdlGpu::CreateUninitializedImage(renderer, w, h, GPU_FORMAT_RGBA);
+  if (!result) {
+    return nullptr;
+  }
+
+  auto image_data = (PbkitSdlGpu::PBKitImageData*)result->data;
+  image_data->format = texture_format;
+  PbkitSdlGpu::AllocateImageStorage(result, byte_length);
+  image_data->mip_levels = mip_levels;
+  result->has_mipmaps = mip_levels > 1 ? GPU_TRUE : GPU_FALSE;
+  memcpy(image_data->data, data, byte_length);
+  return result;
+}
+
+GPU_Image* PBKitSDLGPULoadTextureContainer_RW(SDL_RWops* rwops, GPU_bool free_rwops) {
+  if (!rwops) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_NULL_ARGUMENT, "rwops");
+    return nullptr;
+  }
+
+  GPU_Image* result = nullptr;
+  auto renderer = GPU_GetCurrentRenderer();
+  if (!renderer || renderer->id.renderer != PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_USER_ERROR,
+                      "The pbkit renderer is not active");
+  } else {
+    result = PbkitSdlGpu::LoadTextureContainer(renderer, rwops);
+  }
+
+  if (free_rwops) {
+    SDL_RWclose(rwops);
+  }
+  return result;
+}
+
+GPU_Image* PBKitSDLGPULoadTextureContainer(const char* filename) {
+  auto rwops = SDL_RWFromFile(filename, "rb");
+  if (!rwops) {
+    GPU_PushErrorCode("PBKitSDLGPULoadTextureContainer", GPU_ERROR_FILE_NOT_FOUND, "%s", filename);
+    return nullptr;
+  }
+  return PBKitSDLGPULoadTextureContainer_RW(rwops, GPU_TRUE);
+}
+
+struct PBKitSDLGPUAtlas : PbkitSdlGpu::TextureAtlas {
+  using TextureAtlas::TextureAtlas;
+};
+
+PBKitSDLGPUAtlas* PBKitSDLGPUCreateAtlas(Uint16 page_w, Uint16 page_h) {
+  if (!page_w || !page_h) {
+    GPU_PushErrorCode("PBKitSDLGPUCreateAtlas", GPU_ERROR_USER_ERROR, "Empty page size");
+    return nullptr;
+  }
+  return new PBKitSDLGPUAtlas(page_w, page_h);
+}
+
+void PBKitSDLGPUFreeAtlas(PBKitSDLGPUAtlas* atlas) { delete atlas; }
+
+GPU_Image* PBKitSDLGPUAtlasAddSurface(PBKitSDLGPUAtlas* atlas, SDL_Surface* surface) {
+  if (!atlas) {
+    GPU_PushErrorCode("PBKitSDLGPUAtlasAddSurface", GPU_ERROR_NULL_ARGUMENT, "atlas");
+    return nullptr;
+  }
+  return atlas->AddSurface(surface);
+}
+
+void PBKitSDLGPUAtlasUpload(PBKitSDLGPUAtlas* atlas) {
+  if (atlas) {
+    atlas->Upload();
+  }
+}
+
+Uint32 PBKitSDLGPUCompactTextureMemory() {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (renderer && renderer->id.renderer == PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    // Pending blits are drawn from the textures' current addresses.
+    renderer->impl->FlushBlitBuffer(renderer);
+  }
+  return PbkitSdlGpu::CompactTextureHeap();
+}
+
+void PBKitSDLGPUGetTextureMemoryStats(PBKitSDLGPUTextureMemoryStats* stats) {
+  if (!stats) {
+    GPU_PushErrorCode("PBKitSDLGPUGetTextureMemoryStats", GPU_ERROR_NULL_ARGUMENT, "stats");
+    return;
+  }
+  PbkitSdlGpu::GetTextureHeapStats(stats);
+}
+
+GPU_bool PBKitSDLGPUQueueImageUpdate(GPU_Image* image,
+                                     const GPU_Rect* image_rect,
+                                     SDL_Surface* surface,
+                                     const GPU_Rect* surface_rect) {
+  return PbkitSdlGpu::QueueImageUpdate(image, image_rect, surface, surface_rect) ? GPU_TRUE
+                                                                                 : GPU_FALSE;
+}
+
+void PBKitSDLGPUSetUploadTimeBudget(Uint32 microseconds) {
+  PbkitSdlGpu::upload_time_budget_us = microseconds;
+}
+
+GPU_bool PBKitSDLGPUIsImageUploadPending(GPU_Image* image) {
+  if (!image) {
+    GPU_PushErrorCode("PBKitSDLGPUIsImageUploadPending", GPU_ERROR_NULL_ARGUMENT, "image");
+    return GPU_FALSE;
+  }
+  return PbkitSdlGpu::IsUploadPending(image) ? GPU_TRUE : GPU_FALSE;
+}
+
+void PBKitSDLGPUFinishImageUploads() { PbkitSdlGpu::CompleteUploads(nullptr); }
+
+void PBKitSDLGPUSetTextureBudget(Uint32 budget_bytes, Uint32 idle_frames) {
+  PbkitSdlGpu::SetTextureBudget(budget_bytes, idle_frames);
+}
+
+GPU_bool PBKitSDLGPUSetImageRestoreFile(GPU_Image* image, const char* filename) {
+  return PbkitSdlGpu::SetRestoreFile(image, filename) ? GPU_TRUE : GPU_FALSE;
+}
+
+GPU_bool PBKitSDLGPUSetImageRestoreMemory(GPU_Image* image, const void* data, Uint32 size) {
+  return PbkitSdlGpu::SetRestoreMemory(image, data, size) ? GPU_TRUE : GPU_FALSE;
+}
+
+GPU_bool PBKitSDLGPUSetImageRestoreCallback(GPU_Image* image,
+                                            PBKitSDLGPURestoreImageCallback callback,
+                                            void* userdata) {
+  return PbkitSdlGpu::SetRestoreCallback(image, callback, userdata) ? GPU_TRUE : GPU_FALSE;
+}
+
+GPU_bool PBKitSDLGPUIsImageResident(GPU_Image* image) {
+  if (!image) {
+    GPU_PushErrorCode("PBKitSDLGPUIsImageResident", GPU_ERROR_NULL_ARGUMENT, "image");
+    return GPU_FALSE;
+  }
+  return PbkitSdlGpu::IsImageResident(image) ? GPU_TRUE : GPU_FALSE;
+}
+
+void PBKitSDLGPUSetFramePipelining(Uint32 max_frames_in_flight, GPU_bool wait_for_vblank) {
+  PbkitSdlGpu::SetFramePipelining(max_frames_in_flight, wait_for_vblank);
+}
+
+Uint32 PBKitSDLGPUInsertFence() {
+  auto renderer = GPU_GetCurrentRenderer();
+  if (renderer && renderer->id.renderer == PbkitSdlGpu::GPU_RENDERER_PBKIT) {
+    // The fence must also cover blits that are still batched.
+    renderer->impl->FlushBlitBuffer(renderer);
+  }
+  return PbkitSdlGpu::InsertFence();
+}
+
+GPU_bool PBKitSDLGPUIsFenceComplete(Uint32 fence) {
+  return PbkitSdlGpu::IsFenceComplete(fence) ? GPU_TRUE : GPU_FALSE;
+}
+
+void PBKitSDLGPUWaitForFence(Uint32 fence) { PbkitSdlGpu::WaitForFence(fence); }
+
+Uint32 PBKitSDLGPUGetCompletedFence() { return PbkitSdlGpu::GetCompletedFence(); }
+
+void PBKitSDLGPUSetTransform(const float* matrix) { PbkitSdlGpu::SetTransform(matrix); }
+
+void PBKitSDLGPUResetTransform() { PbkitSdlGpu::SetTransform(nullptr); }
+
 void PBKitSDLGPUInit() {
   PbkitSdlGpu::renderer_id = GPU_MakeRendererID("pbkit", PbkitSdlGpu::GPU_RENDERER_PBKIT, 1, 0);
   GPU_RegisterRenderer(PbkitSdlGpu::renderer_id, &PbkitSdlGpu::CreateRenderer, &PbkitSdlGpu::FreeRenderer);
@@ -1,11 +1,247 @@
 #pragma once
 
+#include "SDL_gpu.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void PBKitSDLGPUInit();
 
+// Discards the renderer's shadow copy of the GPU register state. Must be called
+// after pushing NV097 state through pbkit directly, before rendering through
+// SDL_gpu again.
+void PBKitSDLGPUInvalidateStateCache();
+
+// By default GPU_Flip waits for the GPU to finish the frame before swapping,
+// so the CPU never builds a frame while the GPU renders the previous one.
+// With a non-zero `max_frames_in_flight` (at most 3) GPU_Flip instead queues
+// the swap behind the frame's commands and returns, blocking only once the
+// GPU is more than that many frames behind. With `wait_for_vblank` set it also
+// waits for the next vertical blank, which paces the CPU to the display;
+// otherwise it is paced only by the frames in flight. Passing 0 restores the
+// default.
+//
+// This only pipelines frame submission. Presentation is unchanged: pbkit
+// keeps its own framebuffers and always swaps them during vertical blank, so
+// there is no extra back buffer and no presentation without vsync. The push
+// buffer is only reset while the GPU is idle, so under sustained load it
+// relies on pbkit wrapping it around.
+void PBKitSDLGPUSetFramePipelining(Uint32 max_frames_in_flight, GPU_bool wait_for_vblank);
+
+// Fences track how far the GPU has got through the commands pushed so far
+// without waiting for it to go idle. A fence is complete once the GPU has
+// finished rendering everything drawn before it was inserted, e.g. so that
+// memory the draws read from may be reused. Fence values increase with each
+// fence and are compared with wraparound; 0 is always complete.
+Uint32 PBKitSDLGPUInsertFence();
+GPU_bool PBKitSDLGPUIsFenceComplete(Uint32 fence);
+void PBKitSDLGPUWaitForFence(Uint32 fence);
+
+// Returns the most recent fence the GPU has passed.
+Uint32 PBKitSDLGPUGetCompletedFence();
+
+// Sets a 4x4 column-major matrix (as returned by GPU_GetModelView) that the GPU
+// applies to the position of every subsequently drawn vertex. Positions are in
+// target pixel coordinates. Passing the identity matrix or NULL disables the
+// transform.
+void PBKitSDLGPUSetTransform(const float* matrix);
+
+// Equivalent to PBKitSDLGPUSetTransform(NULL).
+void PBKitSDLGPUResetTransform();
+
+// Creates an image stored in a linear (LU_IMAGE) texture format with no power
+// of two padding. Updates to linear images are plain row copies rather than a
+// full re-swizzle, which suits images that change every frame such as video
+// frames or software-rendered framebuffers. Linear images do not support
+// mipmaps or repeat wrapping.
+GPU_Image* PBKitSDLGPUCreateLinearImage(Uint16 w, Uint16 h, GPU_FormatEnum format);
+
+typedef enum PBKitSDLGPU16BitFormat {
+  PBKIT_SDL_GPU_R5G6B5,
+  PBKIT_SDL_GPU_A1R5G5B5,
+  PBKIT_SDL_GPU_A4R4G4B4,
+} PBKitSDLGPU16BitFormat;
+
+// Creates an image stored with 16 bits per texel, which halves its memory and
+// sampling bandwidth. Updates from 24 and 32 bit surfaces, and
+// GPU_UpdateImageBytes data in GPU_FORMAT_RGBA layout, are converted with each
+// channel rounded. Surfaces whose SDL format matches the texture
+// (SDL_PIXELFORMAT_RGB565, ARGB1555 or ARGB4444) are copied unchanged. If
+// `linear` is set the image is stored as by PBKitSDLGPUCreateLinearImage.
+GPU_Image* PBKitSDLGPUCreate16BitImage(Uint16 w,
+                                       Uint16 h,
+                                       PBKitSDLGPU16BitFormat format,
+                                       GPU_bool linear);
+
+// Enables a 4x4 ordered dither when converting updates of a 16 bit image,
+// which hides the banding of smooth gradients. Only affects later updates.
+void PBKitSDLGPUSetImageDither(GPU_Image* image, GPU_bool dither);
+
+// Creates a GPU_FORMAT_RGBA image stored as A8R8G8B8, the 32 bit layout the
+// GPU can render into, so GPU_LoadTarget can use it as it is. GPU_LoadTarget
+// on other 32 bit images first waits for the GPU to go idle and converts every
+// texel on the CPU, which stalls the frame. If `linear` is set the image is
+// stored as by PBKitSDLGPUCreateLinearImage.
+GPU_Image* PBKitSDLGPUCreateTargetImage(Uint16 w, Uint16 h, GPU_bool linear);
+
+// A 256 entry palette shared by any number of 8 bit indexed (I8) images.
+// GPU_CopyImageFromSurface turns SDL_PIXELFORMAT_INDEX8 surfaces into I8
+// images with a palette of their own, holding the surface colors with the
+// color key, if any, made transparent.
+typedef struct PBKitSDLGPUPalette PBKitSDLGPUPalette;
+
+// Creates a palette whose first `count` entries are `colors`; the rest are
+// transparent black.
+PBKitSDLGPUPalette* PBKitSDLGPUCreatePalette(const SDL_Color* colors, int count);
+
+// Releases the caller's reference. Images using the palette keep it alive.
+void PBKitSDLGPUFreePalette(PBKitSDLGPUPalette* palette);
+
+// Replaces `count` entries starting at `first`. Images drawn before the call
+// keep the old colors. The palette moves to fresh texture memory, so when the
+// texture heap is full this waits for the GPU to release retired blocks.
+void PBKitSDLGPUUpdatePalette(PBKitSDLGPUPalette* palette,
+                              const SDL_Color* colors,
+                              int first,
+                              int count);
+
+// Creates an I8 image sampling from `palette`. Its contents are set with
+// GPU_UpdateImage from SDL_PIXELFORMAT_INDEX8 surfaces or with
+// GPU_UpdateImageBytes from one index per byte.
+GPU_Image* PBKitSDLGPUCreatePalettedImage(Uint16 w, Uint16 h, PBKitSDLGPUPalette* palette);
+
+// Returns the palette of an I8 image, or NULL for any other image. The image
+// keeps its reference; the returned palette is not retained.
+PBKitSDLGPUPalette* PBKitSDLGPUGetImagePalette(GPU_Image* image);
+
+// Makes an I8 image sample from `palette`. Aliases created with
+// GPU_CreateAliasImage have their own palette, so one texture can be drawn
+// with several palettes, e.g. for team colors. Switching palettes costs a
+// single register write.
+void PBKitSDLGPUSetImagePalette(GPU_Image* image, PBKitSDLGPUPalette* palette);
+
+typedef enum PBKitSDLGPUCompressedFormat {
+  PBKIT_SDL_GPU_COMPRESSED_DXT1,
+  PBKIT_SDL_GPU_COMPRESSED_DXT3,
+  PBKIT_SDL_GPU_COMPRESSED_DXT5,
+} PBKitSDLGPUCompressedFormat;
+
+// Creates an image from DXT compressed data. `data` holds `mip_levels` levels
+// of the power of two texture that contains a `w` x `h` image, largest first,
+// each stored as rows of 4x4 blocks with at least one block per level. The
+// blocks are copied into texture memory as they are. Compressed images cannot
+// be updated.
+GPU_Image* PBKitSDLGPUCreateCompressedImage(Uint16 w,
+                                            Uint16 h,
+                                            PBKitSDLGPUCompressedFormat format,
+                                            const void* data,
+                                            Uint32 size,
+                                            Uint8 mip_levels);
+
+// Loads an image from a texture container written by tools/texture_converter.
+// The payload is already swizzled or compressed and is read directly into
+// texture memory.
+GPU_Image* PBKitSDLGPULoadTextureContainer(const char* filename);
+GPU_Image* PBKitSDLGPULoadTextureContainer_RW(SDL_RWops* rwops, GPU_bool free_rwops);
+
+// Packs many small surfaces into shared texture pages. Images returned by
+// PBKitSDLGPUAtlasAddSurface behave like any other image but sample from their
+// page, so consecutive blits of images from the same page are drawn together.
+// Each image must be released with GPU_FreeImage and stays valid after the
+// atlas is freed.
+typedef struct PBKitSDLGPUAtlas PBKitSDLGPUAtlas;
+
+// Creates an atlas whose pages are `page_w` x `page_h` texels. Power of two
+// dimensions avoid wasting texture memory.
+PBKitSDLGPUAtlas* PBKitSDLGPUCreateAtlas(Uint16 page_w, Uint16 page_h);
+void PBKitSDLGPUFreeAtlas(PBKitSDLGPUAtlas* atlas);
+
+// Copies `surface` into the atlas and returns an image referring to it, or NULL
+// if the surface is larger than a page. The image contents are undefined until
+// PBKitSDLGPUAtlasUpload is called.
+GPU_Image* PBKitSDLGPUAtlasAddSurface(PBKitSDLGPUAtlas* atlas, SDL_Surface* surface);
+
+// Uploads every page modified since the previous call.
+void PBKitSDLGPUAtlasUpload(PBKitSDLGPUAtlas* atlas);
+
+// Texture memory is suballocated from large contiguous arenas.
+typedef struct PBKitSDLGPUTextureMemoryStats {
+  Uint32 arena_count;
+  // Contiguous memory held by the arenas.
+  Uint32 reserved_bytes;
+  Uint32 used_bytes;
+  Uint32 allocation_count;
+  // Memory freed while the GPU may still read it, reusable once it has caught up.
+  Uint32 pending_free_bytes;
+  Uint32 free_bytes;
+  Uint32 free_block_count;
+  // The largest texture that fits without reserving another arena.
+  Uint32 largest_free_block;
+} PBKitSDLGPUTextureMemoryStats;
+
+void PBKitSDLGPUGetTextureMemoryStats(PBKitSDLGPUTextureMemoryStats* stats);
+
+// Moves textures together to close the gaps left by freed images and returns
+// arenas that become empty to the system. Waits for the GPU to finish all
+// queued rendering, so it is meant to be called between levels or after
+// freeing a large number of images. Returns the number of bytes moved.
+Uint32 PBKitSDLGPUCompactTextureMemory();
+
+// Queues the equivalent of GPU_UpdateImage to be carried out over the next
+// frames, so that streaming in images does not stall the frame that loads
+// them. GPU_Flip spends up to the upload time budget converting queued
+// updates into a copy of the texture, which replaces the image's texture once
+// complete; draws made before then show the previous contents. Queued updates
+// of an image take effect in order, and any other update of it, or
+// GPU_GenerateMipmaps, first finishes the queued ones. The surface is retained
+// and must not be modified until the upload is done. Updates that cover only
+// part of the texture keep a copy of it in system memory to build from, which
+// is released by the next update that does not go through the queue.
+GPU_bool PBKitSDLGPUQueueImageUpdate(GPU_Image* image,
+                                     const GPU_Rect* image_rect,
+                                     SDL_Surface* surface,
+                                     const GPU_Rect* surface_rect);
+
+// Sets the time GPU_Flip may spend on queued uploads each frame, 2000
+// microseconds by default. At least one slice of work is done per frame.
+void PBKitSDLGPUSetUploadTimeBudget(Uint32 microseconds);
+
+GPU_bool PBKitSDLGPUIsImageUploadPending(GPU_Image* image);
+
+// Finishes every queued upload immediately.
+void PBKitSDLGPUFinishImageUploads();
+
+// Images may give up their texture memory while they are not drawn, so that
+// more content can be loaded than fits in memory at once. An image becomes
+// managed once it has a restore source. At the end of each frame, while more
+// texture memory is in use than the budget allows, managed images that have
+// not been drawn for `idle_frames` frames are evicted, least recently used
+// first. Evicted images stay valid and are refilled from their source the next
+// time they are drawn or updated, which may stall that frame. Changes made to
+// an image outside its source are lost when it is evicted.
+//
+// A budget of 0, the default, disables eviction.
+void PBKitSDLGPUSetTextureBudget(Uint32 budget_bytes, Uint32 idle_frames);
+
+// Refills `image` with GPU_UpdateImage or GPU_UpdateImageBytes. Generated
+// mipmaps are rebuilt afterwards. Returns GPU_FALSE on failure.
+typedef GPU_bool (*PBKitSDLGPURestoreImageCallback)(GPU_Image* image, void* userdata);
+
+// Restores `image` from the texture container `filename`, typically the file
+// it was loaded from with PBKitSDLGPULoadTextureContainer.
+GPU_bool PBKitSDLGPUSetImageRestoreFile(GPU_Image* image, const char* filename);
+
+// Restores `image` from a texture container held in memory. `data` must stay
+// valid while the image exists.
+GPU_bool PBKitSDLGPUSetImageRestoreMemory(GPU_Image* image, const void* data, Uint32 size);
+
+GPU_bool PBKitSDLGPUSetImageRestoreCallback(GPU_Image* image,
+                                            PBKitSDLGPURestoreImageCallback callback,
+                                            void* userdata);
+
+GPU_bool PBKitSDLGPUIsImageResident(GPU_Image* image);
+
 #ifdef __cplusplus
 }; // extern "C"
 #endif
@@ -1,6 +1,8 @@
 #include "precalculated_vertex_shader.h"
 #include <pbkit/pbkit.h>
 #include <string>
+#include "debug_output.h"
+#include "register_cache.h"
 
 namespace PbkitSdlGpu {
 
@@ -25,37 +27,110 @@ static constexpr uint32_t kShader[] = {
     0x00000000, 0x0020121b, 0x0836106c, 0x2070c848, 0x00000000, 0x0020141b, 0x0836106c, 0x2070c850,
     0x00000000, 0x0020161b, 0x0836106c, 0x2070c858, 0x00000000, 0x0020181b, 0x0836106c, 0x2070c861,
 };
+
+// Identical to kShader except that the position is multiplied by the matrix held in c[0] - c[3]
+// (hardware constants 96 - 99).
+static constexpr uint32_t kTransformShader[] = {
+    // dp4 oPos.x, v0, c[0]
+    // dp4 oPos.y, v0, c[1]
+    // dp4 oPos.z, v0, c[2]
+    // dp4 oPos.w, v0, c[3]
+    0x00000000, 0x00ec001b, 0x0836186c, 0x20708800, 0x00000000, 0x00ec201b, 0x0836186c, 0x20704800,
+    0x00000000, 0x00ec401b, 0x0836186c, 0x20702800, 0x00000000, 0x00ec601b, 0x0836186c, 0x20701800,
+    // mov oD0, v3
+    // mov oT0 - oT3, v9 - v12
+    0x00000000, 0x0020061b, 0x0836106c, 0x2070f818, 0x00000000, 0x0020121b, 0x0836106c, 0x2070c848,
+    0x00000000, 0x0020141b, 0x0836106c, 0x2070c850, 0x00000000, 0x0020161b, 0x0836106c, 0x2070c858,
+    0x00000000, 0x0020181b, 0x0836106c, 0x2070c861,
+};
 // clang format on
 
+// The transform program memory holds 136 instructions.
+static constexpr uint32_t kNumProgramSlots = 136;
+static constexpr uint32_t kMaxVertexPrograms = 16;
+
+// NV097_SET_TRANSFORM_PROGRAM is a 32 word method array, so at most 8 instructions may be sent per
+// packet.
+static constexpr uint32_t kInstructionsPerPacket = 8;
+
+struct ResidentVertexProgram {
+  uint32_t start;
+  uint32_t num_instructions;
+};
+
+static ResidentVertexProgram programs[kMaxVertexPrograms];
+static uint32_t num_programs = 0;
+static uint32_t next_free_slot = 0;
+
+static VertexProgramHandle passthrough_program = kInvalidVertexProgram;
+static VertexProgramHandle transform_program = kInvalidVertexProgram;
+
+VertexProgramHandle RegisterVertexProgram(const uint32_t* microcode, uint32_t num_instructions) {
+  if (!num_instructions || num_programs >= kMaxVertexPrograms
+      || next_free_slot + num_instructions > kNumProgramSlots) {
+    return kInvalidVertexProgram;
+  }
+
+  auto& program = programs[num_programs];
+  program.start = next_free_slot;
+  program.num_instructions = num_instructions;
+  next_free_slot += num_instructions;
+
+  // The whole program is uploaded in as few blocks as pbkit's 128 word limit allows.
+  static constexpr uint32_t kPacketsPerBlock = 3;
+  uint32_t uploaded = 0;
+  while (uploaded < num_instructions) {
+    auto p = pb_begin();
+    if (!uploaded) {
+      p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_LOAD, program.start);
+    }
+
+    for (uint32_t packet = 0; packet < kPacketsPerBlock && uploaded < num_instructions; ++packet) {
+      uint32_t count = num_instructions - uploaded;
+      if (count > kInstructionsPerPacket) {
+        count = kInstructionsPerPacket;
+      }
+
+      pb_push(p++, NV097_SET_TRANSFORM_PROGRAM, count * 4);
+      memcpy(p, microcode + uploaded * 4, count * 4 * 4);
+      p += count * 4;
+      uploaded += count;
+    }
+    pb_end(p);
+  }
+
+  return num_programs++;
+}
+
+void UseVertexProgram(VertexProgramHandle program) {
+  PBKITSDLGPU_ASSERT(program < num_programs);
+  SetState(NV097_SET_TRANSFORM_PROGRAM_START, programs[program].start);
+}
+
 void LoadPrecalculatedVertexShader() {
   uint32_t* p;
-  int i;
 
   p = pb_begin();
 
-  // Set run address of shader
-  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_START, 0);
-
-  p = pb_push1(
+  p = PushState(
       p, NV097_SET_TRANSFORM_EXECUTION_MODE,
       MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_MODE_PROGRAM) |
           MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE_PRIV));
 
-  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN, 0);
+  p = PushState(p, NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN, 0);
   pb_end(p);
 
-  // Set cursor and begin copying program
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_LOAD, 0);
-  pb_end(p);
+  // Every program stays resident at its own offset so switching only changes PROGRAM_START.
+  num_programs = 0;
+  next_free_slot = 0;
+  passthrough_program = RegisterVertexProgram(kShader, sizeof(kShader) / 16);
+  transform_program = RegisterVertexProgram(kTransformShader, sizeof(kTransformShader) / 16);
 
-  for (i = 0; i < sizeof(kShader) / 16; i++) {
-    p = pb_begin();
-    pb_push(p++, NV097_SET_TRANSFORM_PROGRAM, 4);
-    memcpy(p, &kShader[i * 4], 4 * 4);
-    p += 4;
-    pb_end(p);
-  }
+  UsePassthroughVertexShader();
 }
 
-} // namespace PbkitSdlGpu
\ No newline at end of file
+void UsePassthroughVertexShader() { UseVertexProgram(passthrough_program); }
+
+void UseTransformVertexShader() { UseVertexProgram(transform_program); }
+
+} // namespace PbkitSdlGpu
@@ -1,6 +1,30 @@
 #pragma once
 
+#include <cstdint>
+
 namespace PbkitSdlGpu {
+// Hardware index of the first of the four transform constants holding the matrix used by
+// UseTransformVertexShader().
+constexpr uint32_t kTransformMatrixConstant = 96;
+
+// Identifies a program registered with RegisterVertexProgram().
+typedef uint32_t VertexProgramHandle;
+constexpr VertexProgramHandle kInvalidVertexProgram = 0xFFFFFFFF;
+
+// Uploads the built-in programs and selects the pass-through program.
 void LoadPrecalculatedVertexShader();
+
+// Uploads `num_instructions` 4-word instructions into unused transform program memory, where
+// they remain resident. Returns kInvalidVertexProgram if there is not enough space.
+VertexProgramHandle RegisterVertexProgram(const uint32_t* microcode, uint32_t num_instructions);
+
+// Makes `program` the active vertex program. This only changes PROGRAM_START.
+void UseVertexProgram(VertexProgramHandle program);
+
+// Selects the program that passes vertices through unmodified.
+void UsePassthroughVertexShader();
+
+// Selects the program that multiplies vertex positions by the matrix at kTransformMatrixConstant.
+void UseTransformVertexShader();
 };
 
@@ -0,0 +1,85 @@
+#include "register_cache.h"
+#include <pbkit/pbkit.h>
+#include <cstring>
+#include "debug_output.h"
+
+namespace PbkitSdlGpu {
+
+// The NV097 method space spans 0x0000 - 0x1FFC.
+static constexpr uint32_t kNumMethods = 0x2000 / 4;
+
+static uint32_t shadow_values[kNumMethods];
+static uint32_t shadow_valid[kNumMethods / 32];
+
+static inline bool IsValid(uint32_t index) { return shadow_valid[index >> 5] & (1u << (index & 31)); }
+
+static inline void Store(uint32_t index, uint32_t value) {
+  shadow_values[index] = value;
+  shadow_valid[index >> 5] |= 1u << (index & 31);
+}
+
+bool StateMatches(uint32_t method, uint32_t value) {
+  PBKITSDLGPU_ASSERT(method < 0x2000 && !(method & 3));
+  uint32_t index = method >> 2;
+  return IsValid(index) && shadow_values[index] == value;
+}
+
+uint32_t* PushState(uint32_t* p, uint32_t method, uint32_t value) {
+  if (StateMatches(method, value)) {
+    return p;
+  }
+
+  Store(method >> 2, value);
+  return pb_push1(p, method, value);
+}
+
+uint32_t* PushStatef(uint32_t* p, uint32_t method, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return PushState(p, method, bits);
+}
+
+uint32_t* PushStateN(uint32_t* p, uint32_t method, const uint32_t* values, uint32_t count) {
+  PBKITSDLGPU_ASSERT(method + count * 4 <= 0x2000);
+  uint32_t index = method >> 2;
+
+  bool dirty = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!IsValid(index + i) || shadow_values[index + i] != values[i]) {
+      dirty = true;
+      break;
+    }
+  }
+  if (!dirty) {
+    return p;
+  }
+
+  pb_push_to(SUBCH_3D, p++, method, count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Store(index + i, values[i]);
+    *(p++) = values[i];
+  }
+  return p;
+}
+
+void SetState(uint32_t method, uint32_t value) {
+  if (StateMatches(method, value)) {
+    return;
+  }
+
+  auto p = pb_begin();
+  p = PushState(p, method, value);
+  pb_end(p);
+}
+
+void InvalidateState(uint32_t method, uint32_t count) {
+  PBKITSDLGPU_ASSERT(method + count * 4 <= 0x2000);
+  uint32_t index = method >> 2;
+  for (uint32_t i = 0; i < count; ++i, ++index) {
+    shadow_valid[index >> 5] &= ~(1u << (index & 31));
+  }
+}
+
+void InvalidateAllState() { memset(shadow_valid, 0, sizeof(shadow_valid)); }
+
+}  // namespace PbkitSdlGpu
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PbkitSdlGpu {
+
+// Shadow copy of the NV097 (Kelvin) state most recently sent to the GPU.
+//
+// State setters are filtered through the cache so that values which are already
+// in effect are never re-emitted. Only idempotent state methods may be cached;
+// methods with side effects (NV097_SET_BEGIN_END, vertex data, inline arrays and
+// auto-incrementing loads such as NV097_SET_TRANSFORM_PROGRAM) must bypass it.
+//
+// Any code that writes a cached method without going through these functions
+// must call InvalidateState() or InvalidateAllState() afterwards.
+
+// Appends `method` = `value` to the push buffer at `p` unless it is already set.
+uint32_t* PushState(uint32_t* p, uint32_t method, uint32_t value);
+uint32_t* PushStatef(uint32_t* p, uint32_t method, float value);
+
+// Appends `count` consecutive methods starting at `method` as a single packet
+// unless every one of them already holds the given value.
+uint32_t* PushStateN(uint32_t* p, uint32_t method, const uint32_t* values, uint32_t count);
+
+// Returns true if `method` is known to hold `value`.
+bool StateMatches(uint32_t method, uint32_t value);
+
+// Sets a single method, opening a push buffer block only if the value changes.
+void SetState(uint32_t method, uint32_t value);
+
+// Forgets the cached value of `count` consecutive methods starting at `method`.
+void InvalidateState(uint32_t method, uint32_t count = 1);
+
+// Forgets all cached values.
+void InvalidateAllState();
+
+}  // namespace PbkitSdlGpu
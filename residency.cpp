@@ -0,0 +1,266 @@
+#include "residency.h"
+
+#include "debug_output.h"
+#include "image_data.h"
+#include "texture_container.h"
+#include "texture_heap.h"
+
+namespace PbkitSdlGpu {
+
+struct ManagedImage {
+  // The image that owns the texture memory.
+  GPU_Image* image;
+
+  // Exactly one source is set.
+  char* filename;
+  const void* memory;
+  uint32_t memory_size;
+  PBKitSDLGPURestoreImageCallback callback;
+  void* userdata;
+
+  uint32_t last_used_frame;
+  // Neighbors in the list of resident images. Evicted images are not in the list.
+  ManagedImage* newer;
+  ManagedImage* older;
+};
+
+static uint32_t budget = 0;
+static uint32_t idle_frame_count = 0;
+static uint32_t current_frame = 0;
+
+// Ends of the list of resident managed images, ordered by the frame they were last used in.
+static ManagedImage* newest = nullptr;
+static ManagedImage* oldest = nullptr;
+
+static void Unlink(ManagedImage* managed) {
+  (managed->newer ? managed->newer->older : newest) = managed->older;
+  (managed->older ? managed->older->newer : oldest) = managed->newer;
+  managed->newer = nullptr;
+  managed->older = nullptr;
+}
+
+static void LinkNewest(ManagedImage* managed) {
+  managed->newer = nullptr;
+  managed->older = newest;
+  (newest ? newest->newer : oldest) = managed;
+  newest = managed;
+}
+
+static void Evict(ManagedImage* managed) {
+  auto image_data = (PBKitImageData*)managed->image->data;
+  Unlink(managed);
+  // The texture is refilled from its restore source rather than the texels queued updates knew.
+  image_data->DropCachedTexels();
+  // Draws still in flight keep sampling the memory until the GPU has passed them.
+  FreeTextureMemory(image_data->data);
+  image_data->data = nullptr;
+}
+
+// Returns the entry for `image`, created if needed, with its previous source cleared.
+static ManagedImage* GetManagedImage(GPU_Image* image, const char* function) {
+  if (!image) {
+    GPU_PushErrorCode(function, GPU_ERROR_NULL_ARGUMENT, "image");
+    return nullptr;
+  }
+
+  auto image_data = (PBKitImageData*)image->data;
+  if (image_data->owner) {
+    GPU_PushErrorCode(function, GPU_ERROR_USER_ERROR,
+                      "Aliases follow the residency of the image they were created from");
+    return nullptr;
+  }
+
+  auto managed = image_data->managed;
+  if (!managed) {
+    managed = (ManagedImage*)SDL_calloc(1, sizeof(ManagedImage));
+    if (!managed) {
+      GPU_PushErrorCode(function, GPU_ERROR_BACKEND_ERROR, "Failed to allocate residency state");
+      return nullptr;
+    }
+    managed->image = image;
+    managed->last_used_frame = current_frame;
+    LinkNewest(managed);
+    image_data->managed = managed;
+    return managed;
+  }
+
+  SDL_free(managed->filename);
+  managed->filename = nullptr;
+  managed->memory = nullptr;
+  managed->memory_size = 0;
+  managed->callback = nullptr;
+  managed->userdata = nullptr;
+  return managed;
+}
+
+// Reads the payload of a texture container into the texture memory of `image_data`, provided the
+// container holds the same texture. Closes `rwops`.
+static bool ReadContainerPayload(SDL_RWops* rwops, PBKitImageData* image_data) {
+  if (!rwops) {
+    return false;
+  }
+
+  PBKitTextureContainerHeader header;
+  bool ok = SDL_RWread(rwops, &header, sizeof(header), 1) == 1
+            && header.magic == PBKIT_TEXTURE_CONTAINER_MAGIC
+            && header.version == PBKIT_TEXTURE_CONTAINER_VERSION
+            && header.format == (uint32_t)image_data->format && header.size_u == image_data->size_u
+            && header.size_v == image_data->size_v && header.mip_count == image_data->mip_levels
+            && header.payload_size <= image_data->byte_length
+            && SDL_RWread(rwops, image_data->data, header.payload_size, 1) == 1;
+  SDL_RWclose(rwops);
+  return ok;
+}
+
+static bool RestoreImage(ManagedImage* managed) {
+  auto image = managed->image;
+  auto image_data = (PBKitImageData*)image->data;
+
+  // Make room by evicting the least recently used images not needed for the current frame, only
+  // as many as the allocation requires.
+  while (!AllocateTextureMemory(image_data->byte_length, &image_data->data)) {
+    if (!oldest || oldest->last_used_frame == current_frame) {
+      GPU_PushErrorCode("PBKitSDLGPURestoreImage", GPU_ERROR_BACKEND_ERROR,
+                        "Failed to allocate %u bytes of texture memory", image_data->byte_length);
+      return false;
+    }
+    Evict(oldest);
+  }
+
+  // The image is resident before it is filled so that a callback may update it.
+  managed->last_used_frame = current_frame;
+  LinkNewest(managed);
+
+  bool restored;
+  if (managed->callback) {
+    restored = managed->callback(image, managed->userdata);
+    if (restored && image->has_mipmaps && image_data->mip_levels > 1) {
+      GPU_GenerateMipmaps(image);
+    }
+  } else if (managed->filename) {
+    restored = ReadContainerPayload(SDL_RWFromFile(managed->filename, "rb"), image_data);
+  } else {
+    restored =
+        ReadContainerPayload(SDL_RWFromConstMem(managed->memory, managed->memory_size), image_data);
+  }
+
+  if (!restored) {
+    GPU_PushErrorCode("PBKitSDLGPURestoreImage", GPU_ERROR_DATA_ERROR,
+                      "Failed to refill the texture of an evicted image");
+    Evict(managed);
+    return false;
+  }
+  return true;
+}
+
+void SetTextureBudget(uint32_t budget_bytes, uint32_t idle_frames) {
+  budget = budget_bytes;
+  idle_frame_count = idle_frames;
+}
+
+bool SetRestoreFile(GPU_Image* image, const char* filename) {
+  if (!filename) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImageRestoreFile", GPU_ERROR_NULL_ARGUMENT, "filename");
+    return false;
+  }
+
+  auto managed = GetManagedImage(image, "PBKitSDLGPUSetImageRestoreFile");
+  if (!managed) {
+    return false;
+  }
+  managed->filename = SDL_strdup(filename);
+  return true;
+}
+
+bool SetRestoreMemory(GPU_Image* image, const void* data, uint32_t size) {
+  if (!data) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImageRestoreMemory", GPU_ERROR_NULL_ARGUMENT, "data");
+    return false;
+  }
+
+  auto managed = GetManagedImage(image, "PBKitSDLGPUSetImageRestoreMemory");
+  if (!managed) {
+    return false;
+  }
+  managed->memory = data;
+  managed->memory_size = size;
+  return true;
+}
+
+bool SetRestoreCallback(GPU_Image* image, PBKitSDLGPURestoreImageCallback callback, void* userdata) {
+  if (!callback) {
+    GPU_PushErrorCode("PBKitSDLGPUSetImageRestoreCallback", GPU_ERROR_NULL_ARGUMENT, "callback");
+    return false;
+  }
+
+  auto managed = GetManagedImage(image, "PBKitSDLGPUSetImageRestoreCallback");
+  if (!managed) {
+    return false;
+  }
+  managed->callback = callback;
+  managed->userdata = userdata;
+  return true;
+}
+
+void StopManagingImage(GPU_Image* image) {
+  auto image_data = (PBKitImageData*)image->data;
+  auto managed = image_data->managed;
+  if (!managed) {
+    return;
+  }
+
+  if (!image_data->data && image_data->refcount > 1) {
+    RestoreImage(managed);
+  }
+  if (image_data->data) {
+    Unlink(managed);
+  }
+
+  SDL_free(managed->filename);
+  SDL_free(managed);
+  image_data->managed = nullptr;
+}
+
+bool MakeImageResident(GPU_Image* image) {
+  auto image_data = (PBKitImageData*)image->data;
+  auto owner = image_data->owner ? image_data->owner : image_data;
+  if (owner->data) {
+    TouchImage(owner);
+    return true;
+  }
+
+  PBKITSDLGPU_ASSERT(owner->managed);
+  return RestoreImage(owner->managed);
+}
+
+bool IsImageResident(const GPU_Image* image) {
+  return ((const PBKitImageData*)image->data)->TextureData() != nullptr;
+}
+
+void TouchImage(PBKitImageData* image_data) {
+  auto managed = image_data->managed;
+  if (!managed || managed->last_used_frame == current_frame) {
+    return;
+  }
+
+  managed->last_used_frame = current_frame;
+  Unlink(managed);
+  LinkNewest(managed);
+}
+
+void EndTextureFrame() {
+  if (budget) {
+    PBKitSDLGPUTextureMemoryStats stats;
+    GetTextureHeapStats(&stats);
+    uint32_t in_use = stats.used_bytes;
+    while (in_use > budget && oldest && current_frame - oldest->last_used_frame >= idle_frame_count) {
+      auto image_data = (PBKitImageData*)oldest->image->data;
+      in_use -= (image_data->byte_length + kTextureAlignment - 1) & ~(kTextureAlignment - 1);
+      Evict(oldest);
+    }
+  }
+
+  ++current_frame;
+}
+
+}  // namespace PbkitSdlGpu
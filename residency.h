@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SDL_gpu.h"
+#include "pbkit_sdl_gpu.h"
+
+namespace PbkitSdlGpu {
+
+struct PBKitImageData;
+
+// Lets images give up their texture memory while they are not being drawn.
+//
+// An image becomes managed once it is given a restore source: a texture container file, a
+// texture container in memory, or a callback that fills the image. At the end of each frame, while
+// the texture memory in use exceeds the budget, managed images that have not been bound for the
+// configured number of frames are evicted, least recently used first. An evicted image keeps its
+// GPU_Image, dimensions and format; its texture memory is allocated and refilled from the source
+// the next time it is drawn or updated.
+//
+// Managed images are kept in a list ordered by the frame they were last used in, so the least
+// recently used ones are found without a search.
+
+// A budget of 0 disables eviction.
+void SetTextureBudget(uint32_t budget_bytes, uint32_t idle_frames);
+
+// Each of these makes `image` managed, replacing any previous source. Only images that own their
+// texture memory may be managed; aliases follow the image they were created from.
+bool SetRestoreFile(GPU_Image* image, const char* filename);
+bool SetRestoreMemory(GPU_Image* image, const void* data, uint32_t size);
+bool SetRestoreCallback(GPU_Image* image, PBKitSDLGPURestoreImageCallback callback, void* userdata);
+
+// Stops managing the texture of `image`, which owns it and is being freed. If aliases still refer to
+// the texture it is restored first, since it can no longer be refilled once the image is gone.
+void StopManagingImage(GPU_Image* image);
+
+// Ensures the texture memory of `image`, or of the image it aliases, is allocated and filled, and
+// marks it used in the current frame. Returns false if an evicted texture could not be restored.
+bool MakeImageResident(GPU_Image* image);
+
+bool IsImageResident(const GPU_Image* image);
+
+// Marks the texture of `image_data` used in the current frame.
+void TouchImage(PBKitImageData* image_data);
+
+// Evicts idle images while the budget is exceeded and starts a new frame. Called once per frame
+// after the last draw of the frame has been pushed.
+void EndTextureFrame();
+
+}  // namespace PbkitSdlGpu
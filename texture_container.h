@@ -0,0 +1,39 @@
+#pragma once
+
+// Layout of the pre-swizzled texture container written by
+// tools/texture_converter and loaded by PBKitSDLGPULoadTextureContainer.
+//
+// A container is a PBKitTextureContainerHeader followed immediately by
+// `payload_size` bytes of texture data in exactly the layout the NV2A samples
+// it from: each of the `mip_count` levels is swizzled and stored back to back,
+// starting with the largest. All fields are little-endian.
+//
+// DXT compressed payloads (formats L_DXT1_A1R5G5B5, L_DXT23_A8R8G8B8 and
+// L_DXT45_A8R8G8B8) are not swizzled: each level is a row-order array of 4x4
+// blocks, with at least one block per level, and `bytes_per_pixel` is 0.
+
+#include <stdint.h>
+
+#define PBKIT_TEXTURE_CONTAINER_MAGIC 0x58544250  // "PBTX"
+#define PBKIT_TEXTURE_CONTAINER_VERSION 1
+
+typedef struct PBKitTextureContainerHeader {
+  uint32_t magic;
+  uint32_t version;
+  // NV097_SET_TEXTURE_FORMAT_COLOR_* value of the payload.
+  uint32_t format;
+  // Dimensions of the image content, which may be smaller than the texture.
+  uint16_t width;
+  uint16_t height;
+  // log2 of the texture dimensions.
+  uint8_t size_u;
+  uint8_t size_v;
+  uint8_t mip_count;
+  // 4 for uncompressed formats, 0 for DXT.
+  uint8_t bytes_per_pixel;
+  uint32_t payload_size;
+} PBKitTextureContainerHeader;
+
+#ifdef __cplusplus
+static_assert(sizeof(PBKitTextureContainerHeader) == 24, "Unexpected container header size");
+#endif
@@ -0,0 +1,271 @@
+#include "texture_heap.h"
+#include <pbkit/nv_regs.h>
+#include <windows.h>
+#include <xmmintrin.h>
+#include <cstring>
+#include <vector>
+#include "debug_output.h"
+#include "fence.h"
+#include "palette.h"
+#include "register_cache.h"
+
+#define MAXRAM 0x03FFAFFF
+
+namespace PbkitSdlGpu {
+
+// Arenas are reserved in this size unless a single allocation needs more.
+static constexpr uint32_t kArenaSize = 4 * 1024 * 1024;
+static constexpr uint32_t kPageSize = 4096;
+
+// Blocks tile their arena in address order. A block without an owner is free once its fence has
+// been passed; until then it may still be read by the GPU.
+struct TextureHeapBlock {
+  uint32_t offset;
+  uint32_t size;
+  uint8_t** owner;
+  uint32_t retire_fence;
+
+  bool IsFree() const { return !owner && !retire_fence; }
+};
+
+struct TextureArena {
+  uint8_t* base;
+  uint32_t size;
+  std::vector<TextureHeapBlock> blocks;
+};
+
+static std::vector<TextureArena> arenas;
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void CoalesceFreeBlocks(TextureArena* arena) {
+  auto& blocks = arena->blocks;
+  for (size_t i = 0; i + 1 < blocks.size();) {
+    if (blocks[i].IsFree() && blocks[i + 1].IsFree()) {
+      blocks[i].size += blocks[i + 1].size;
+      blocks.erase(blocks.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+// Returns blocks whose fence has been passed to the free list. Returns true if any blocks are still
+// waiting on the GPU.
+static bool ReclaimRetiredBlocks() {
+  bool pending = false;
+  for (auto& arena : arenas) {
+    bool reclaimed = false;
+    for (auto& block : arena.blocks) {
+      if (block.owner || !block.retire_fence) {
+        continue;
+      }
+      if (IsFenceComplete(block.retire_fence)) {
+        block.retire_fence = 0;
+        reclaimed = true;
+      } else {
+        pending = true;
+      }
+    }
+    if (reclaimed) {
+      CoalesceFreeBlocks(&arena);
+    }
+  }
+  return pending;
+}
+
+static TextureArena* ReserveArena(uint32_t size) {
+  size = size > kArenaSize ? AlignUp(size, kPageSize) : kArenaSize;
+  auto base = static_cast<uint8_t*>(
+      MmAllocateContiguousMemoryEx(size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
+  if (!base) {
+    return nullptr;
+  }
+
+  arenas.push_back({ base, size, { { 0, size, nullptr, 0 } } });
+  return &arenas.back();
+}
+
+// Places `size` bytes in the smallest free block that holds them.
+static uint8_t* AllocateFromFreeBlocks(uint32_t size, uint8_t** owner) {
+  TextureArena* best_arena = nullptr;
+  size_t best_block = 0;
+  for (auto& arena : arenas) {
+    for (size_t i = 0; i < arena.blocks.size(); ++i) {
+      const auto& block = arena.blocks[i];
+      if (!block.IsFree() || block.size < size) {
+        continue;
+      }
+      if (!best_arena || block.size < best_arena->blocks[best_block].size) {
+        best_arena = &arena;
+        best_block = i;
+      }
+    }
+  }
+
+  if (!best_arena) {
+    return nullptr;
+  }
+
+  auto& blocks = best_arena->blocks;
+  auto& block = blocks[best_block];
+  if (block.size > size) {
+    TextureHeapBlock remainder = { block.offset + size, block.size - size, nullptr, 0 };
+    block.size = size;
+    blocks.insert(blocks.begin() + best_block + 1, remainder);
+  }
+
+  auto& allocated = blocks[best_block];
+  allocated.owner = owner;
+  *owner = best_arena->base + allocated.offset;
+  return *owner;
+}
+
+uint8_t* AllocateTextureMemory(uint32_t size, uint8_t** owner) {
+  size = AlignUp(size ? size : 1, kTextureAlignment);
+
+  bool pending = ReclaimRetiredBlocks();
+  auto ret = AllocateFromFreeBlocks(size, owner);
+  if (ret) {
+    return ret;
+  }
+
+  // Memory freed recently may be enough; waiting for the GPU is preferable to growing the heap.
+  if (pending) {
+    WaitForFence(InsertFence());
+    ReclaimRetiredBlocks();
+    ret = AllocateFromFreeBlocks(size, owner);
+    if (ret) {
+      return ret;
+    }
+  }
+
+  if (!ReserveArena(size)) {
+    return nullptr;
+  }
+  return AllocateFromFreeBlocks(size, owner);
+}
+
+void FreeTextureMemory(uint8_t* memory) {
+  if (!memory) {
+    return;
+  }
+
+  for (auto& arena : arenas) {
+    if (memory < arena.base || memory >= arena.base + arena.size) {
+      continue;
+    }
+
+    uint32_t offset = memory - arena.base;
+    for (auto& block : arena.blocks) {
+      if (block.offset == offset && block.owner) {
+        block.owner = nullptr;
+        block.retire_fence = InsertFence();
+        return;
+      }
+    }
+    break;
+  }
+
+  PBKITSDLGPU_ASSERT(!"Freeing memory that is not a texture heap allocation");
+}
+
+void TransferTextureMemory(uint8_t* memory, uint8_t** owner) {
+  for (auto& arena : arenas) {
+    if (memory < arena.base || memory >= arena.base + arena.size) {
+      continue;
+    }
+
+    uint32_t offset = memory - arena.base;
+    for (auto& block : arena.blocks) {
+      if (block.offset == offset && block.owner) {
+        block.owner = owner;
+        *owner = memory;
+        return;
+      }
+    }
+    break;
+  }
+
+  PBKITSDLGPU_ASSERT(!"Transferring memory that is not a texture heap allocation");
+}
+
+uint32_t CompactTextureHeap() {
+  // Textures are about to move underneath commands that may still be in flight.
+  WaitForFence(InsertFence());
+  ReclaimRetiredBlocks();
+
+  uint32_t bytes_moved = 0;
+  for (auto& arena : arenas) {
+    std::vector<TextureHeapBlock> compacted;
+    uint32_t end = 0;
+    for (auto& block : arena.blocks) {
+      if (!block.owner) {
+        continue;
+      }
+
+      if (block.offset != end) {
+        // Blocks only move towards the start of the arena, so earlier blocks are never
+        // overwritten before they have been moved.
+        memmove(arena.base + end, arena.base + block.offset, block.size);
+        *block.owner = arena.base + end;
+        bytes_moved += block.size;
+      }
+      compacted.push_back({ end, block.size, block.owner, 0 });
+      end += block.size;
+    }
+
+    if (end < arena.size) {
+      compacted.push_back({ end, arena.size - end, nullptr, 0 });
+    }
+    arena.blocks = std::move(compacted);
+  }
+
+  for (size_t i = 0; i < arenas.size();) {
+    if (arenas[i].blocks.size() == 1 && arenas[i].blocks[0].IsFree()) {
+      MmFreeContiguousMemory(arenas[i].base);
+      arenas.erase(arenas.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+
+  if (bytes_moved) {
+    // Flush the write-combining buffers before the GPU samples the moved textures.
+    _mm_sfence();
+
+    // A cached offset may now belong to a different texture or palette.
+    for (uint32_t stage = 0; stage < 4; ++stage) {
+      InvalidateState(NV20_TCL_PRIMITIVE_3D_TX_OFFSET(stage));
+      InvalidateState(NV097_SET_TEXTURE_PALETTE + stage * 64);
+    }
+  }
+
+  return bytes_moved;
+}
+
+void GetTextureHeapStats(PBKitSDLGPUTextureMemoryStats* stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->arena_count = arenas.size();
+  for (const auto& arena : arenas) {
+    stats->reserved_bytes += arena.size;
+    for (const auto& block : arena.blocks) {
+      if (block.owner) {
+        stats->used_bytes += block.size;
+        ++stats->allocation_count;
+      } else if (block.retire_fence) {
+        stats->pending_free_bytes += block.size;
+      } else {
+        stats->free_bytes += block.size;
+        ++stats->free_block_count;
+        if (block.size > stats->largest_free_block) {
+          stats->largest_free_block = block.size;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace PbkitSdlGpu
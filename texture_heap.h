@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pbkit_sdl_gpu.h"
+
+namespace PbkitSdlGpu {
+
+// Suballocates texture memory from large write-combined contiguous arenas.
+//
+// Each allocation records the address of the pointer that refers to it, its owner, so that
+// CompactTextureHeap() can move the allocation and update that pointer. Owners must therefore
+// stay at a fixed address for the lifetime of the allocation and must be the only place the
+// address is kept.
+//
+// Freed memory is only reused once the GPU has passed every draw pushed before it was freed.
+
+// Texture offsets given to the GPU are aligned to this many bytes.
+static constexpr uint32_t kTextureAlignment = 128;
+
+// Returns at least `size` bytes of texture memory and stores the address in `*owner`, or returns
+// NULL if no arena has room and a new one cannot be reserved.
+uint8_t* AllocateTextureMemory(uint32_t size, uint8_t** owner);
+
+// Releases memory returned by AllocateTextureMemory.
+void FreeTextureMemory(uint8_t* memory);
+
+// Hands memory returned by AllocateTextureMemory over to a new owner and stores its address there.
+void TransferTextureMemory(uint8_t* memory, uint8_t** owner);
+
+// Slides every allocation to the start of its arena, closing the gaps between them, and returns
+// arenas that are left empty to the system. Waits for the GPU to go idle first. Returns the number
+// of bytes moved.
+uint32_t CompactTextureHeap();
+
+void GetTextureHeapStats(PBKitSDLGPUTextureMemoryStats* stats);
+
+}  // namespace PbkitSdlGpu
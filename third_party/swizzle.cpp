@@ -22,8 +22,13 @@
 #include "swizzle.h"
 
 #include <cassert>
+#include <cstring>
 #include <string>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 namespace PbkitSdlGpu {
 /* This should be pretty straightforward.
  * It creates a bit pattern like ..zyxzyxzyx from ..xxx, ..yyy and ..zzz
@@ -55,49 +60,520 @@ static void generate_swizzle_masks(unsigned int width, unsigned int height, unsi
     }
     bit <<= 1;
   } while (!done);
-  assert(x ^ y ^ z == (mask_bit - 1));
+  assert((x ^ y ^ z) == (mask_bit - 1));
   *mask_x = x;
   *mask_y = y;
   *mask_z = z;
 }
 
-/* This fills a pattern with a value if your value has bits abcd and your
- * pattern is 11010100100 this will return: 0a0b0c00d00
+/* Instead of scattering the bits of every coordinate with a loop, the swizzled
+ * offset of each axis is advanced incrementally. Subtracting the mask and
+ * masking again carries through the bits that do not belong to the axis, which
+ * yields the next offset along that axis:
+ *   offset_x = (offset_x - mask_x) & mask_x
+ * The offsets of the individual axes never overlap, so they are simply or'ed.
  */
-static uint32_t fill_pattern(uint32_t pattern, uint32_t value) {
-  uint32_t result = 0;
-  uint32_t bit = 1;
-  while (value) {
-    if (pattern & bit) {
-      /* Copy bit to result */
-      result |= value & 1 ? bit : 0;
+static inline uint32_t next_swizzled_offset(uint32_t offset, uint32_t mask) { return (offset - mask) & mask; }
+
+/* Returns the swizzled offset of coordinate `value` along the axis described
+ * by `mask`, scattering its bits into the set bits of the mask. Used to find
+ * the starting offset of a sub-rectangle.
+ */
+static uint32_t swizzled_offset(uint32_t value, uint32_t mask) {
+  uint32_t offset = 0;
+  for (uint32_t bit = 1; value && mask; bit <<= 1) {
+    if (mask & bit) {
+      if (value & 1) {
+        offset |= bit;
+      }
       value >>= 1;
+      mask &= ~bit;
     }
-    bit <<= 1;
   }
-  return result;
+  return offset;
 }
 
-static unsigned int get_swizzled_offset(unsigned int x, unsigned int y, unsigned int z, uint32_t mask_x,
-                                        uint32_t mask_y, uint32_t mask_z, unsigned int bytes_per_pixel) {
-  return bytes_per_pixel * (fill_pattern(mask_x, x) | fill_pattern(mask_y, y) | fill_pattern(mask_z, z));
+/* Copies a single row between linear and swizzled memory. T is an integer type
+ * of the same size as a pixel, so the copy compiles to a single move.
+ */
+template <typename T>
+static void swizzle_row(const uint8_t *src, uint8_t *dst, unsigned int width, uint32_t mask_x, uint32_t offset_yz,
+                        uint32_t offset_x = 0) {
+  for (unsigned int x = 0; x < width; x++) {
+    T value;
+    memcpy(&value, src + x * sizeof(T), sizeof(T));
+    memcpy(dst + (offset_x | offset_yz) * sizeof(T), &value, sizeof(T));
+    offset_x = next_swizzled_offset(offset_x, mask_x);
+  }
 }
 
+template <typename T>
+static void unswizzle_row(const uint8_t *src, uint8_t *dst, unsigned int width, uint32_t mask_x, uint32_t offset_yz) {
+  uint32_t offset_x = 0;
+  for (unsigned int x = 0; x < width; x++) {
+    T value;
+    memcpy(&value, src + (offset_x | offset_yz) * sizeof(T), sizeof(T));
+    memcpy(dst + x * sizeof(T), &value, sizeof(T));
+    offset_x = next_swizzled_offset(offset_x, mask_x);
+  }
+}
+
+static void swizzle_row_generic(const uint8_t *src, uint8_t *dst, unsigned int width, uint32_t mask_x,
+                                uint32_t offset_yz, unsigned int bytes_per_pixel, uint32_t offset_x = 0) {
+  for (unsigned int x = 0; x < width; x++) {
+    memcpy(dst + (offset_x | offset_yz) * bytes_per_pixel, src + x * bytes_per_pixel, bytes_per_pixel);
+    offset_x = next_swizzled_offset(offset_x, mask_x);
+  }
+}
+
+static void unswizzle_row_generic(const uint8_t *src, uint8_t *dst, unsigned int width, uint32_t mask_x,
+                                  uint32_t offset_yz, unsigned int bytes_per_pixel) {
+  uint32_t offset_x = 0;
+  for (unsigned int x = 0; x < width; x++) {
+    memcpy(dst + x * bytes_per_pixel, src + (offset_x | offset_yz) * bytes_per_pixel, bytes_per_pixel);
+    offset_x = next_swizzled_offset(offset_x, mask_x);
+  }
+}
+
+#ifdef __SSE__
+/* Swizzles a 32bpp rectangle whose position and dimensions are multiples of 4
+ * one 4x4 tile at a time, starting at the swizzled offsets (start_x, start_y).
+ * The lowest four bits of the swizzle pattern are then always yxyx, so every
+ * tile occupies 64 contiguous bytes:
+ *   row 0 [0,1] row 1 [0,1] | row 0 [2,3] row 1 [2,3] | row 2 [0,1] row 3 [0,1] | row 2 [2,3] row 3 [2,3]
+ * Each tile is written as four sequential non-temporal 16-byte stores, which
+ * lets write-combined destinations be filled a full line at a time. Only SSE1
+ * moves are used since the Xbox CPU does not support SSE2; they copy the
+ * 32-bit values without interpreting them.
+ */
+static void swizzle_rect_32bpp_tiled(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                                     unsigned int pitch, uint32_t mask_x, uint32_t mask_y, uint32_t start_x = 0,
+                                     uint32_t start_y = 0) {
+  /* Drop the two lowest bits of each axis, stepping the offsets a tile at a time. */
+  const uint32_t tile_mask_x = mask_x & ~0x5u;
+  const uint32_t tile_mask_y = mask_y & ~0xAu;
+  const bool aligned_dst = !((uintptr_t)dst_buf & 0xF);
+
+  uint32_t offset_y = start_y;
+  for (unsigned int y = 0; y < height; y += 4) {
+    const uint8_t *row = src_buf + y * pitch;
+    uint32_t offset_x = start_x;
+    for (unsigned int x = 0; x < width; x += 4) {
+      const uint8_t *src = row + x * 4;
+      __m128 r0 = _mm_loadu_ps(reinterpret_cast<const float *>(src));
+      __m128 r1 = _mm_loadu_ps(reinterpret_cast<const float *>(src + pitch));
+      __m128 r2 = _mm_loadu_ps(reinterpret_cast<const float *>(src + pitch * 2));
+      __m128 r3 = _mm_loadu_ps(reinterpret_cast<const float *>(src + pitch * 3));
+
+      float *dst = reinterpret_cast<float *>(dst_buf + (offset_x | offset_y) * 4);
+      if (aligned_dst) {
+        _mm_stream_ps(dst, _mm_movelh_ps(r0, r1));
+        _mm_stream_ps(dst + 4, _mm_movehl_ps(r1, r0));
+        _mm_stream_ps(dst + 8, _mm_movelh_ps(r2, r3));
+        _mm_stream_ps(dst + 12, _mm_movehl_ps(r3, r2));
+      } else {
+        _mm_storeu_ps(dst, _mm_movelh_ps(r0, r1));
+        _mm_storeu_ps(dst + 4, _mm_movehl_ps(r1, r0));
+        _mm_storeu_ps(dst + 8, _mm_movelh_ps(r2, r3));
+        _mm_storeu_ps(dst + 12, _mm_movehl_ps(r3, r2));
+      }
+
+      offset_x = next_swizzled_offset(offset_x, tile_mask_x);
+    }
+    offset_y = next_swizzled_offset(offset_y, tile_mask_y);
+  }
+
+  _mm_sfence();
+}
+
+/* The 16bpp counterpart of swizzle_rect_32bpp_tiled. A tile is 32 bytes, and
+ * each pair of adjacent texels in a tile row moves as one 32-bit value:
+ *   row 0 [0,1] row 1 [0,1] row 0 [2,3] row 1 [2,3] | row 2 [0,1] row 3 [0,1] row 2 [2,3] row 3 [2,3]
+ * so loading each 8-byte row into the low half of a register and
+ * interleaving rows 0/1 and 2/3 yields the tile as two 16-byte stores.
+ */
+static void swizzle_rect_16bpp_tiled(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                                     unsigned int pitch, uint32_t mask_x, uint32_t mask_y, uint32_t start_x = 0,
+                                     uint32_t start_y = 0) {
+  const uint32_t tile_mask_x = mask_x & ~0x5u;
+  const uint32_t tile_mask_y = mask_y & ~0xAu;
+  const bool aligned_dst = !((uintptr_t)dst_buf & 0xF);
+  const __m128 zero = _mm_setzero_ps();
+
+  uint32_t offset_y = start_y;
+  for (unsigned int y = 0; y < height; y += 4) {
+    const uint8_t *row = src_buf + y * pitch;
+    uint32_t offset_x = start_x;
+    for (unsigned int x = 0; x < width; x += 4) {
+      const uint8_t *src = row + x * 2;
+      __m128 r0 = _mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(src));
+      __m128 r1 = _mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(src + pitch));
+      __m128 r2 = _mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(src + pitch * 2));
+      __m128 r3 = _mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(src + pitch * 3));
+
+      float *dst = reinterpret_cast<float *>(dst_buf + (offset_x | offset_y) * 2);
+      if (aligned_dst) {
+        _mm_stream_ps(dst, _mm_unpacklo_ps(r0, r1));
+        _mm_stream_ps(dst + 4, _mm_unpacklo_ps(r2, r3));
+      } else {
+        _mm_storeu_ps(dst, _mm_unpacklo_ps(r0, r1));
+        _mm_storeu_ps(dst + 4, _mm_unpacklo_ps(r2, r3));
+      }
+
+      offset_x = next_swizzled_offset(offset_x, tile_mask_x);
+    }
+    offset_y = next_swizzled_offset(offset_y, tile_mask_y);
+  }
+
+  _mm_sfence();
+}
+#endif
+
 void swizzle_box(const uint8_t *src_buf, unsigned int width, unsigned int height, unsigned int depth, uint8_t *dst_buf,
                  unsigned int row_pitch, unsigned int slice_pitch, unsigned int bytes_per_pixel) {
   uint32_t mask_x, mask_y, mask_z;
   generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
 
-  int x, y, z;
-  for (z = 0; z < depth; z++) {
-    for (y = 0; y < height; y++) {
-      for (x = 0; x < width; x++) {
-        const uint8_t *src = src_buf + y * row_pitch + x * bytes_per_pixel;
-        uint8_t *dst = dst_buf + get_swizzled_offset(x, y, z, mask_x, mask_y, mask_z, bytes_per_pixel);
-        memcpy(dst, src, bytes_per_pixel);
+#ifdef __SSE__
+  if (bytes_per_pixel == 4 && depth == 1 && width >= 4 && height >= 4) {
+    swizzle_rect_32bpp_tiled(src_buf, width, height, dst_buf, row_pitch, mask_x, mask_y);
+    return;
+  }
+  if (bytes_per_pixel == 2 && depth == 1 && width >= 4 && height >= 4) {
+    swizzle_rect_16bpp_tiled(src_buf, width, height, dst_buf, row_pitch, mask_x, mask_y);
+    return;
+  }
+#endif
+
+  uint32_t offset_z = 0;
+  for (unsigned int z = 0; z < depth; z++) {
+    uint32_t offset_y = 0;
+    for (unsigned int y = 0; y < height; y++) {
+      const uint8_t *src = src_buf + y * row_pitch;
+      uint32_t offset_yz = offset_y | offset_z;
+      switch (bytes_per_pixel) {
+        case 1:
+          swizzle_row<uint8_t>(src, dst_buf, width, mask_x, offset_yz);
+          break;
+        case 2:
+          swizzle_row<uint16_t>(src, dst_buf, width, mask_x, offset_yz);
+          break;
+        case 4:
+          swizzle_row<uint32_t>(src, dst_buf, width, mask_x, offset_yz);
+          break;
+        default:
+          swizzle_row_generic(src, dst_buf, width, mask_x, offset_yz, bytes_per_pixel);
+          break;
       }
+      offset_y = next_swizzled_offset(offset_y, mask_y);
     }
     src_buf += slice_pitch;
+    offset_z = next_swizzled_offset(offset_z, mask_z);
+  }
+}
+
+/* Swizzles a sub-rectangle of a texture one row at a time. */
+static void swizzle_subrect_rows(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width,
+                                 unsigned int height, uint8_t *dst_buf, unsigned int pitch, unsigned int bytes_per_pixel,
+                                 uint32_t mask_x, uint32_t mask_y) {
+  if (!width) {
+    return;
+  }
+
+  uint32_t start_x = swizzled_offset(x, mask_x);
+  uint32_t offset_y = swizzled_offset(y, mask_y);
+  for (unsigned int row = 0; row < height; row++) {
+    const uint8_t *src = src_buf + row * pitch;
+    switch (bytes_per_pixel) {
+      case 1:
+        swizzle_row<uint8_t>(src, dst_buf, width, mask_x, offset_y, start_x);
+        break;
+      case 2:
+        swizzle_row<uint16_t>(src, dst_buf, width, mask_x, offset_y, start_x);
+        break;
+      case 4:
+        swizzle_row<uint32_t>(src, dst_buf, width, mask_x, offset_y, start_x);
+        break;
+      default:
+        swizzle_row_generic(src, dst_buf, width, mask_x, offset_y, bytes_per_pixel, start_x);
+        break;
+    }
+    offset_y = next_swizzled_offset(offset_y, mask_y);
+  }
+}
+
+void swizzle_subrect(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                     uint8_t *dst_buf, unsigned int texture_width, unsigned int texture_height, unsigned int pitch,
+                     unsigned int bytes_per_pixel) {
+  assert(x + width <= texture_width && y + height <= texture_height);
+
+  uint32_t mask_x, mask_y, mask_z;
+  generate_swizzle_masks(texture_width, texture_height, 1, &mask_x, &mask_y, &mask_z);
+
+#ifdef __SSE__
+  /* The 4x4 aligned interior goes through the tiled kernel, the edges around
+   * it are done a row at a time.
+   */
+  if ((bytes_per_pixel == 4 || bytes_per_pixel == 2) && texture_width >= 4 && texture_height >= 4) {
+    unsigned int left = (x + 3) & ~3u;
+    unsigned int right = (x + width) & ~3u;
+    unsigned int top = (y + 3) & ~3u;
+    unsigned int bottom = (y + height) & ~3u;
+    if (left < right && top < bottom) {
+      const uint8_t *interior = src_buf + (top - y) * pitch;
+      auto tiled = bytes_per_pixel == 4 ? swizzle_rect_32bpp_tiled : swizzle_rect_16bpp_tiled;
+      tiled(interior + (left - x) * bytes_per_pixel, right - left, bottom - top, dst_buf, pitch, mask_x, mask_y,
+            swizzled_offset(left, mask_x), swizzled_offset(top, mask_y));
+
+      swizzle_subrect_rows(src_buf, x, y, width, top - y, dst_buf, pitch, bytes_per_pixel, mask_x, mask_y);
+      swizzle_subrect_rows(src_buf + (bottom - y) * pitch, x, bottom, width, y + height - bottom, dst_buf, pitch,
+                           bytes_per_pixel, mask_x, mask_y);
+      swizzle_subrect_rows(interior, x, top, left - x, bottom - top, dst_buf, pitch, bytes_per_pixel, mask_x,
+                           mask_y);
+      swizzle_subrect_rows(interior + (right - x) * bytes_per_pixel, right, top, x + width - right, bottom - top,
+                           dst_buf, pitch, bytes_per_pixel, mask_x, mask_y);
+      return;
+    }
+  }
+#endif
+
+  swizzle_subrect_rows(src_buf, x, y, width, height, dst_buf, pitch, bytes_per_pixel, mask_x, mask_y);
+}
+
+static inline uint32_t convert_texel(const uint8_t *src, const TexelConversion &conversion) {
+  uint32_t texel = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    int source_byte = conversion.source_byte[i];
+    texel |= (uint32_t)(source_byte < 0 ? 0xFF : src[source_byte]) << (i * 8);
+  }
+  return texel;
+}
+
+/* Adds the bytes of `a` and `b` lane by lane, saturating at 0xFF. The top bit
+ * of each lane is summed separately so that carries never cross lanes.
+ */
+static inline uint32_t add_saturate_u8x4(uint32_t a, uint32_t b) {
+  uint32_t sum = (a & 0x7F7F7F7Fu) + (b & 0x7F7F7F7Fu);
+  uint32_t top = (a ^ b) & 0x80808080u;
+  uint32_t overflow = ((a & b) | (top & sum)) & 0x80808080u;
+  return (sum ^ top) | ((overflow >> 7) * 0xFF);
+}
+
+/* Packs A8R8G8B8 texels into a 16 bit layout. The rounding or dither bias of
+ * all four channels is added at once with add_saturate_u8x4, after which each
+ * channel only has to be truncated.
+ */
+struct TexelPacker {
+  TexelPacking packing;
+  /* Bias for each position of the 4x4 dither pattern, or a constant half step. */
+  uint32_t bias[16];
+};
+
+static void init_texel_packer(TexelPacker *packer, const TexelConversion &conversion) {
+  static constexpr uint8_t kBayer4x4[16] = {0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5};
+
+  /* Bits kept of blue, green, red and alpha. A1R5G5B5 alpha is thresholded at
+   * 128 rather than rounded so that binary alpha stays as it is.
+   */
+  unsigned int bits[4] = {8, 8, 8, 8};
+  switch (conversion.packing) {
+    case TexelPacking::kR5G6B5:
+      bits[0] = 5, bits[1] = 6, bits[2] = 5, bits[3] = 0;
+      break;
+    case TexelPacking::kA1R5G5B5:
+      bits[0] = 5, bits[1] = 5, bits[2] = 5, bits[3] = 0;
+      break;
+    case TexelPacking::kA4R4G4B4:
+      bits[0] = 4, bits[1] = 4, bits[2] = 4, bits[3] = 4;
+      break;
+    case TexelPacking::k8888:
+    case TexelPacking::kI8:
+      break;
+  }
+
+  packer->packing = conversion.packing;
+  for (unsigned int i = 0; i < 16; i++) {
+    uint32_t bias = 0;
+    for (unsigned int channel = 0; channel < 4; channel++) {
+      if (!bits[channel] || bits[channel] == 8) {
+        continue;
+      }
+      uint32_t step = 1u << (8 - bits[channel]);
+      uint32_t value = conversion.dither ? (kBayer4x4[i] * step) >> 4 : step >> 1;
+      bias |= value << (channel * 8);
+    }
+    packer->bias[i] = bias;
+  }
+}
+
+/* Packs `texel`, which lands at (x, y) in the texture. */
+static inline uint16_t pack_texel(const TexelPacker &packer, uint32_t texel, unsigned int x, unsigned int y) {
+  texel = add_saturate_u8x4(texel, packer.bias[((y & 3) << 2) | (x & 3)]);
+  switch (packer.packing) {
+    case TexelPacking::kR5G6B5:
+      return ((texel >> 8) & 0xF800) | ((texel >> 5) & 0x07E0) | ((texel >> 3) & 0x001F);
+    case TexelPacking::kA1R5G5B5:
+      return ((texel >> 16) & 0x8000) | ((texel >> 9) & 0x7C00) | ((texel >> 6) & 0x03E0) | ((texel >> 3) & 0x001F);
+    default:
+      return ((texel >> 16) & 0xF000) | ((texel >> 12) & 0x0F00) | ((texel >> 8) & 0x00F0) | ((texel >> 4) & 0x000F);
+  }
+}
+
+/* Converts the pixel at `src` and stores it as texel `index` of `dst_buf`. */
+static inline void store_converted_texel(const uint8_t *src, uint8_t *dst_buf, uint32_t index,
+                                         const TexelConversion &conversion, const TexelPacker &packer, unsigned int x,
+                                         unsigned int y) {
+  uint32_t texel = convert_texel(src, conversion);
+  if (conversion.packing == TexelPacking::k8888) {
+    memcpy(dst_buf + index * 4, &texel, 4);
+  } else {
+    uint16_t packed = pack_texel(packer, texel, x, y);
+    memcpy(dst_buf + index * 2, &packed, 2);
+  }
+}
+
+static void swizzle_subrect_convert_rows(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width,
+                                         unsigned int height, uint8_t *dst_buf, unsigned int pitch,
+                                         const TexelConversion &conversion, const TexelPacker &packer,
+                                         uint32_t mask_x, uint32_t mask_y) {
+  if (!width) {
+    return;
+  }
+
+  uint32_t start_x = swizzled_offset(x, mask_x);
+  uint32_t offset_y = swizzled_offset(y, mask_y);
+  for (unsigned int row = 0; row < height; row++) {
+    const uint8_t *src = src_buf + row * pitch;
+    uint32_t offset_x = start_x;
+    for (unsigned int column = 0; column < width; column++) {
+      store_converted_texel(src, dst_buf, offset_x | offset_y, conversion, packer, x + column, y + row);
+      src += conversion.bytes_per_pixel;
+      offset_x = next_swizzled_offset(offset_x, mask_x);
+    }
+    offset_y = next_swizzled_offset(offset_y, mask_y);
+  }
+}
+
+#ifdef __SSE__
+/* The converting counterpart of swizzle_rect_32bpp_tiled and
+ * swizzle_rect_16bpp_tiled. Each 4x4 tile is assembled in swizzled order on
+ * the stack and then streamed out, so the source is read and the destination
+ * written exactly once. Tiles are aligned to the dither pattern, so texel i of
+ * a tile always takes bias i.
+ */
+static void swizzle_rect_convert_tiled(const uint8_t *src_buf, unsigned int width, unsigned int height,
+                                       uint8_t *dst_buf, unsigned int pitch, const TexelConversion &conversion,
+                                       const TexelPacker &packer, uint32_t mask_x, uint32_t mask_y, uint32_t start_x,
+                                       uint32_t start_y) {
+  const uint32_t tile_mask_x = mask_x & ~0x5u;
+  const uint32_t tile_mask_y = mask_y & ~0xAu;
+  const unsigned int bytes_per_pixel = conversion.bytes_per_pixel;
+  const unsigned int texel_bytes = conversion.TexelSize();
+  const bool aligned_dst = !((uintptr_t)dst_buf & 0xF);
+
+  /* Position of each texel of a tile, in source order, within the swizzled tile. */
+  static constexpr uint8_t kTileOrder[16] = {0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15};
+
+  alignas(16) uint32_t tile[16];
+  uint16_t *packed_tile = reinterpret_cast<uint16_t *>(tile);
+  uint32_t offset_y = start_y;
+  for (unsigned int y = 0; y < height; y += 4) {
+    const uint8_t *row = src_buf + y * pitch;
+    uint32_t offset_x = start_x;
+    for (unsigned int x = 0; x < width; x += 4) {
+      const uint8_t *src = row + x * bytes_per_pixel;
+      for (unsigned int i = 0; i < 16; i++) {
+        uint32_t texel = convert_texel(src + (i >> 2) * pitch + (i & 3) * bytes_per_pixel, conversion);
+        if (texel_bytes == 4) {
+          tile[kTileOrder[i]] = texel;
+        } else {
+          packed_tile[kTileOrder[i]] = pack_texel(packer, texel, i & 3, i >> 2);
+        }
+      }
+
+      float *dst = reinterpret_cast<float *>(dst_buf + (offset_x | offset_y) * texel_bytes);
+      const float *texels = reinterpret_cast<const float *>(tile);
+      for (unsigned int i = 0; i < texel_bytes * 4; i += 4) {
+        if (aligned_dst) {
+          _mm_stream_ps(dst + i, _mm_load_ps(texels + i));
+        } else {
+          _mm_storeu_ps(dst + i, _mm_load_ps(texels + i));
+        }
+      }
+
+      offset_x = next_swizzled_offset(offset_x, tile_mask_x);
+    }
+    offset_y = next_swizzled_offset(offset_y, tile_mask_y);
+  }
+
+  _mm_sfence();
+}
+#endif
+
+void swizzle_subrect_convert(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width,
+                             unsigned int height, uint8_t *dst_buf, unsigned int texture_width,
+                             unsigned int texture_height, unsigned int pitch, const TexelConversion &conversion) {
+  if (conversion.IsIdentity()) {
+    swizzle_subrect(src_buf, x, y, width, height, dst_buf, texture_width, texture_height, pitch,
+                    conversion.TexelSize());
+    return;
+  }
+
+  assert(x + width <= texture_width && y + height <= texture_height);
+
+  uint32_t mask_x, mask_y, mask_z;
+  generate_swizzle_masks(texture_width, texture_height, 1, &mask_x, &mask_y, &mask_z);
+
+  TexelPacker packer;
+  init_texel_packer(&packer, conversion);
+
+#ifdef __SSE__
+  if (texture_width >= 4 && texture_height >= 4) {
+    const unsigned int bytes_per_pixel = conversion.bytes_per_pixel;
+    unsigned int left = (x + 3) & ~3u;
+    unsigned int right = (x + width) & ~3u;
+    unsigned int top = (y + 3) & ~3u;
+    unsigned int bottom = (y + height) & ~3u;
+    if (left < right && top < bottom) {
+      const uint8_t *interior = src_buf + (top - y) * pitch;
+      swizzle_rect_convert_tiled(interior + (left - x) * bytes_per_pixel, right - left, bottom - top, dst_buf, pitch,
+                                 conversion, packer, mask_x, mask_y, swizzled_offset(left, mask_x),
+                                 swizzled_offset(top, mask_y));
+
+      swizzle_subrect_convert_rows(src_buf, x, y, width, top - y, dst_buf, pitch, conversion, packer, mask_x,
+                                   mask_y);
+      swizzle_subrect_convert_rows(src_buf + (bottom - y) * pitch, x, bottom, width, y + height - bottom, dst_buf,
+                                   pitch, conversion, packer, mask_x, mask_y);
+      swizzle_subrect_convert_rows(interior, x, top, left - x, bottom - top, dst_buf, pitch, conversion, packer,
+                                   mask_x, mask_y);
+      swizzle_subrect_convert_rows(interior + (right - x) * bytes_per_pixel, right, top, x + width - right,
+                                   bottom - top, dst_buf, pitch, conversion, packer, mask_x, mask_y);
+      return;
+    }
+  }
+#endif
+
+  swizzle_subrect_convert_rows(src_buf, x, y, width, height, dst_buf, pitch, conversion, packer, mask_x, mask_y);
+}
+
+void convert_rect(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                  unsigned int src_pitch, unsigned int dst_pitch, const TexelConversion &conversion, unsigned int x,
+                  unsigned int y) {
+  TexelPacker packer;
+  init_texel_packer(&packer, conversion);
+
+  for (unsigned int row = 0; row < height; row++) {
+    const uint8_t *src = src_buf + row * src_pitch;
+    uint8_t *dst = dst_buf + row * dst_pitch;
+    if (conversion.IsIdentity()) {
+      memcpy(dst, src, width * conversion.TexelSize());
+      continue;
+    }
+
+    for (unsigned int column = 0; column < width; column++) {
+      store_converted_texel(src, dst, column, conversion, packer, x + column, y + row);
+      src += conversion.bytes_per_pixel;
+    }
   }
 }
 
@@ -106,16 +582,30 @@ void unswizzle_box(const uint8_t *src_buf, unsigned int width, unsigned int heig
   uint32_t mask_x, mask_y, mask_z;
   generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
 
-  int x, y, z;
-  for (z = 0; z < depth; z++) {
-    for (y = 0; y < height; y++) {
-      for (x = 0; x < width; x++) {
-        const uint8_t *src = src_buf + get_swizzled_offset(x, y, z, mask_x, mask_y, mask_z, bytes_per_pixel);
-        uint8_t *dst = dst_buf + y * row_pitch + x * bytes_per_pixel;
-        memcpy(dst, src, bytes_per_pixel);
+  uint32_t offset_z = 0;
+  for (unsigned int z = 0; z < depth; z++) {
+    uint32_t offset_y = 0;
+    for (unsigned int y = 0; y < height; y++) {
+      uint8_t *dst = dst_buf + y * row_pitch;
+      uint32_t offset_yz = offset_y | offset_z;
+      switch (bytes_per_pixel) {
+        case 1:
+          unswizzle_row<uint8_t>(src_buf, dst, width, mask_x, offset_yz);
+          break;
+        case 2:
+          unswizzle_row<uint16_t>(src_buf, dst, width, mask_x, offset_yz);
+          break;
+        case 4:
+          unswizzle_row<uint32_t>(src_buf, dst, width, mask_x, offset_yz);
+          break;
+        default:
+          unswizzle_row_generic(src_buf, dst, width, mask_x, offset_yz, bytes_per_pixel);
+          break;
       }
+      offset_y = next_swizzled_offset(offset_y, mask_y);
     }
     dst_buf += slice_pitch;
+    offset_z = next_swizzled_offset(offset_z, mask_z);
   }
 }
 
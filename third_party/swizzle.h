@@ -36,4 +36,51 @@ void unswizzle_rect(const uint8_t *src_buf, unsigned int width, unsigned int hei
 void swizzle_rect(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf, unsigned int pitch,
                   unsigned int bytes_per_pixel);
 
+// Swizzles the `width` x `height` rectangle at `src_buf` into the texels at (x, y) of the
+// `texture_width` x `texture_height` swizzled texture at `dst_buf`, leaving the rest untouched.
+void swizzle_subrect(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                     uint8_t *dst_buf, unsigned int texture_width, unsigned int texture_height, unsigned int pitch,
+                     unsigned int bytes_per_pixel);
+
+// Texel layouts produced by a TexelConversion. The 16 bit layouts are packed from the A8R8G8B8 texel
+// the conversion assembles, rounding each channel or, with `dither`, applying a 4x4 ordered dither
+// anchored to the texel's position in the texture. A1R5G5B5 alpha is never dithered. 8 bit palette
+// indices can only be copied.
+enum class TexelPacking { k8888, kR5G6B5, kA1R5G5B5, kA4R4G4B4, kI8 };
+
+inline unsigned int texel_size(TexelPacking packing) {
+  return packing == TexelPacking::k8888 ? 4 : packing == TexelPacking::kI8 ? 1 : 2;
+}
+
+// Describes how texels are assembled from source pixels of `bytes_per_pixel` bytes. Byte i of each
+// 32bpp texel is copied from byte `source_byte[i]` of the pixel, or set to 0xFF if it is negative.
+//
+// A conversion whose source pixels already have the texel layout (`bytes_per_pixel` equal to the
+// texel size and `source_byte` {0, 1, 2, 3}) copies them unchanged, whatever the packing.
+struct TexelConversion {
+  unsigned int bytes_per_pixel;
+  int source_byte[4];
+  TexelPacking packing = TexelPacking::k8888;
+  bool dither = false;
+
+  unsigned int TexelSize() const { return texel_size(packing); }
+
+  bool IsIdentity() const {
+    return bytes_per_pixel == TexelSize() && source_byte[0] == 0 && source_byte[1] == 1 && source_byte[2] == 2 &&
+           source_byte[3] == 3;
+  }
+};
+
+// Equivalent to swizzle_subrect with texels of `conversion.TexelSize()` bytes, converting each pixel
+// as it is read.
+void swizzle_subrect_convert(const uint8_t *src_buf, unsigned int x, unsigned int y, unsigned int width,
+                             unsigned int height, uint8_t *dst_buf, unsigned int texture_width,
+                             unsigned int texture_height, unsigned int pitch, const TexelConversion &conversion);
+
+// Converts a `width` x `height` rectangle into linear texels. (`x`, `y`) is the position of the
+// rectangle in the texture, which anchors the dither pattern.
+void convert_rect(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                  unsigned int src_pitch, unsigned int dst_pitch, const TexelConversion &conversion,
+                  unsigned int x = 0, unsigned int y = 0);
+
 } // namespace PbkitSdlGpu
\ No newline at end of file
@@ -0,0 +1,193 @@
+// Compares the throughput of swizzle_rect against the original per-pixel
+// implementation and verifies that both produce identical output. Also compares
+// re-swizzling a whole texture against swizzle_subrect for a small update.
+//
+// Note that the 32bpp path uses non-temporal stores intended for the Xbox's
+// write-combined texture memory. On the host these bypass the cache, so its
+// throughput is bound by memory bandwidth.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "swizzle.h"
+
+namespace reference {
+
+// The per-pixel implementation from QEMU that swizzle.cpp originally used.
+//
+// Copyright (c) 2015 Jannik Vogel
+// Copyright (c) 2013 espes
+// Copyright (c) 2007-2010 The Nouveau Project.
+//
+// Licensed under the GNU Lesser General Public License version 2 or later.
+
+static void generate_swizzle_masks(unsigned int width, unsigned int height, unsigned int depth, uint32_t *mask_x,
+                                   uint32_t *mask_y, uint32_t *mask_z) {
+  uint32_t x = 0, y = 0, z = 0;
+  uint32_t bit = 1;
+  uint32_t mask_bit = 1;
+  bool done;
+  do {
+    done = true;
+    if (bit < width) {
+      x |= mask_bit;
+      mask_bit <<= 1;
+      done = false;
+    }
+    if (bit < height) {
+      y |= mask_bit;
+      mask_bit <<= 1;
+      done = false;
+    }
+    if (bit < depth) {
+      z |= mask_bit;
+      mask_bit <<= 1;
+      done = false;
+    }
+    bit <<= 1;
+  } while (!done);
+  *mask_x = x;
+  *mask_y = y;
+  *mask_z = z;
+}
+
+static uint32_t fill_pattern(uint32_t pattern, uint32_t value) {
+  uint32_t result = 0;
+  uint32_t bit = 1;
+  while (value) {
+    if (pattern & bit) {
+      result |= value & 1 ? bit : 0;
+      value >>= 1;
+    }
+    bit <<= 1;
+  }
+  return result;
+}
+
+static void swizzle_rect(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                         unsigned int pitch, unsigned int bytes_per_pixel) {
+  uint32_t mask_x, mask_y, mask_z;
+  generate_swizzle_masks(width, height, 1, &mask_x, &mask_y, &mask_z);
+
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      const uint8_t *src = src_buf + y * pitch + x * bytes_per_pixel;
+      uint8_t *dst =
+          dst_buf + bytes_per_pixel * (fill_pattern(mask_x, x) | fill_pattern(mask_y, y) | fill_pattern(mask_z, 0));
+      memcpy(dst, src, bytes_per_pixel);
+    }
+  }
+}
+
+}  // namespace reference
+
+typedef void (*SwizzleFunc)(const uint8_t *, unsigned int, unsigned int, uint8_t *, unsigned int, unsigned int);
+
+// Returns the throughput of `func` in MB/s of source data.
+static double Measure(SwizzleFunc func, const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, unsigned int size,
+                      unsigned int bytes_per_pixel) {
+  using Clock = std::chrono::steady_clock;
+
+  const double bytes = (double)size * size * bytes_per_pixel;
+  // Aim for roughly 256MB of data per measurement.
+  unsigned int iterations = (unsigned int)(256.0 * 1024 * 1024 / bytes);
+  if (iterations < 4) {
+    iterations = 4;
+  }
+
+  auto start = Clock::now();
+  for (unsigned int i = 0; i < iterations; ++i) {
+    func(src.data(), size, size, dst.data(), size * bytes_per_pixel, bytes_per_pixel);
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  return bytes * iterations / elapsed.count() / (1024.0 * 1024.0);
+}
+
+// Checks that swizzle_subrect of a `width` x `height` block at (x, y) of a `size` x `size` 32bpp
+// texture matches re-swizzling the whole texture, then prints the time taken by each per update.
+static bool BenchmarkSubrect(unsigned int size, unsigned int x, unsigned int y, unsigned int width,
+                             unsigned int height) {
+  using Clock = std::chrono::steady_clock;
+  static constexpr unsigned int kIterations = 2000;
+
+  std::vector<uint8_t> image(size * size * 4);
+  std::vector<uint8_t> block(width * height * 4);
+  for (auto &value : image) {
+    value = (uint8_t)rand();
+  }
+  for (auto &value : block) {
+    value = (uint8_t)rand();
+  }
+
+  std::vector<uint8_t> expected(image.size());
+  std::vector<uint8_t> actual(image.size());
+  PbkitSdlGpu::swizzle_rect(image.data(), size, size, actual.data(), size * 4, 4);
+  for (unsigned int row = 0; row < height; ++row) {
+    memcpy(&image[((y + row) * size + x) * 4], &block[row * width * 4], width * 4);
+  }
+  reference::swizzle_rect(image.data(), size, size, expected.data(), size * 4, 4);
+  PbkitSdlGpu::swizzle_subrect(block.data(), x, y, width, height, actual.data(), size, size, width * 4, 4);
+  if (expected != actual) {
+    printf("Mismatch updating %ux%u at (%u, %u) of %ux%u\n", width, height, x, y, size, size);
+    return false;
+  }
+
+  auto start = Clock::now();
+  for (unsigned int i = 0; i < kIterations; ++i) {
+    PbkitSdlGpu::swizzle_rect(image.data(), size, size, actual.data(), size * 4, 4);
+  }
+  std::chrono::duration<double, std::micro> full = Clock::now() - start;
+
+  start = Clock::now();
+  for (unsigned int i = 0; i < kIterations; ++i) {
+    PbkitSdlGpu::swizzle_subrect(block.data(), x, y, width, height, actual.data(), size, size, width * 4, 4);
+  }
+  std::chrono::duration<double, std::micro> partial = Clock::now() - start;
+
+  printf("%4u %3ux%-3u (%3u,%3u) %12.2f %12.2f\n", size, width, height, x, y, full.count() / kIterations,
+         partial.count() / kIterations);
+  return true;
+}
+
+int main() {
+  static constexpr unsigned int kBytesPerPixel[] = {1, 2, 4};
+  static constexpr unsigned int kSizes[] = {64, 256, 512, 1024};
+
+  bool failed = false;
+  printf("%4s %6s %14s %14s %8s\n", "bpp", "size", "reference MB/s", "swizzle MB/s", "speedup");
+
+  for (auto bytes_per_pixel : kBytesPerPixel) {
+    for (auto size : kSizes) {
+      std::vector<uint8_t> src(size * size * bytes_per_pixel);
+      for (auto &value : src) {
+        value = (uint8_t)rand();
+      }
+
+      std::vector<uint8_t> expected(src.size());
+      std::vector<uint8_t> actual(src.size());
+      reference::swizzle_rect(src.data(), size, size, expected.data(), size * bytes_per_pixel, bytes_per_pixel);
+      PbkitSdlGpu::swizzle_rect(src.data(), size, size, actual.data(), size * bytes_per_pixel, bytes_per_pixel);
+      if (expected != actual) {
+        printf("Mismatch at %ubpp %ux%u\n", bytes_per_pixel, size, size);
+        failed = true;
+        continue;
+      }
+
+      double reference_rate = Measure(reference::swizzle_rect, src, expected, size, bytes_per_pixel);
+      double rate = Measure(PbkitSdlGpu::swizzle_rect, src, actual, size, bytes_per_pixel);
+      printf("%4u %6u %14.1f %14.1f %7.1fx\n", bytes_per_pixel, size, reference_rate, rate, rate / reference_rate);
+    }
+  }
+
+  printf("\n%4s %7s %9s %12s %12s\n", "size", "update", "at", "full us", "subrect us");
+  failed |= !BenchmarkSubrect(1024, 128, 256, 64, 16);
+  failed |= !BenchmarkSubrect(1024, 101, 250, 64, 16);
+  failed |= !BenchmarkSubrect(256, 3, 7, 250, 201);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+// A straightforward S3TC encoder. Color endpoints are the two texels at the extremes of the block's
+// principal axis, which is a good fit for most blocks without an iterative search.
+
+#include "dxt_encoder.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+struct Color {
+  int r, g, b;
+};
+
+uint16_t PackColor565(const Color& color) {
+  int r = (color.r * 31 + 127) / 255;
+  int g = (color.g * 63 + 127) / 255;
+  int b = (color.b * 31 + 127) / 255;
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+Color UnpackColor565(uint16_t value) {
+  int r = (value >> 11) & 0x1F;
+  int g = (value >> 5) & 0x3F;
+  int b = value & 0x1F;
+  return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+int ColorDistance(const Color& a, const Color& b) {
+  int dr = a.r - b.r;
+  int dg = a.g - b.g;
+  int db = a.b - b.b;
+  return dr * dr + dg * dg + db * db;
+}
+
+void WriteLE(uint8_t* dest, uint64_t value, uint32_t bytes) {
+  for (uint32_t i = 0; i < bytes; ++i) {
+    dest[i] = (uint8_t)(value >> (i * 8));
+  }
+}
+
+// Returns the indices of the texels at either end of the principal axis of `colors`.
+void FindEndpoints(const Color* colors, const bool* used, int* first, int* second) {
+  float mean[3] = {0, 0, 0};
+  int count = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (used[i]) {
+      mean[0] += colors[i].r;
+      mean[1] += colors[i].g;
+      mean[2] += colors[i].b;
+      ++count;
+    }
+  }
+  for (auto& value : mean) {
+    value /= count;
+  }
+
+  float covariance[3][3] = {};
+  for (int i = 0; i < 16; ++i) {
+    if (!used[i]) {
+      continue;
+    }
+    float d[3] = {colors[i].r - mean[0], colors[i].g - mean[1], colors[i].b - mean[2]};
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 3; ++column) {
+        covariance[row][column] += d[row] * d[column];
+      }
+    }
+  }
+
+  // A few rounds of power iteration are enough to separate the dominant axis.
+  float axis[3] = {1, 1, 1};
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    float next[3];
+    for (int row = 0; row < 3; ++row) {
+      next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+    }
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f) {
+      break;
+    }
+    for (int row = 0; row < 3; ++row) {
+      axis[row] = next[row] / length;
+    }
+  }
+
+  float min_projection = 0;
+  float max_projection = 0;
+  *first = -1;
+  *second = -1;
+  for (int i = 0; i < 16; ++i) {
+    if (!used[i]) {
+      continue;
+    }
+    float projection = colors[i].r * axis[0] + colors[i].g * axis[1] + colors[i].b * axis[2];
+    if (*first < 0 || projection < min_projection) {
+      min_projection = projection;
+      *first = i;
+    }
+    if (*second < 0 || projection > max_projection) {
+      max_projection = projection;
+      *second = i;
+    }
+  }
+}
+
+// Writes the 8 byte color part of a block. If `transparent` has any texels set the block uses the
+// three color mode and maps them to the transparent index.
+void EncodeColorBlock(const uint8_t (*texels)[4], const bool* transparent, uint8_t* dest) {
+  Color colors[16];
+  bool used[16];
+  bool any_used = false;
+  bool any_transparent = false;
+  for (int i = 0; i < 16; ++i) {
+    colors[i] = {texels[i][0], texels[i][1], texels[i][2]};
+    used[i] = !transparent[i];
+    any_used |= used[i];
+    any_transparent |= transparent[i];
+  }
+
+  uint16_t c0 = 0;
+  uint16_t c1 = 0;
+  if (any_used) {
+    int first, second;
+    FindEndpoints(colors, used, &first, &second);
+    c0 = PackColor565(colors[second]);
+    c1 = PackColor565(colors[first]);
+  }
+
+  // Four color blocks need c0 > c1, three color blocks c0 <= c1.
+  if (any_transparent ? c0 > c1 : c0 < c1) {
+    uint16_t temp = c0;
+    c0 = c1;
+    c1 = temp;
+  }
+
+  Color palette[4];
+  palette[0] = UnpackColor565(c0);
+  palette[1] = UnpackColor565(c1);
+  int palette_size = 4;
+  if (c0 > c1) {
+    palette[2] = {(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3,
+                  (2 * palette[0].b + palette[1].b) / 3};
+    palette[3] = {(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3,
+                  (palette[0].b + 2 * palette[1].b) / 3};
+  } else {
+    palette[2] = {(palette[0].r + palette[1].r) / 2, (palette[0].g + palette[1].g) / 2,
+                  (palette[0].b + palette[1].b) / 2};
+    palette_size = 3;
+  }
+
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; ++i) {
+    uint32_t index = 3;
+    if (!transparent[i]) {
+      int best_distance = -1;
+      for (int p = 0; p < palette_size; ++p) {
+        int distance = ColorDistance(colors[i], palette[p]);
+        if (best_distance < 0 || distance < best_distance) {
+          best_distance = distance;
+          index = p;
+        }
+      }
+    }
+    indices |= index << (i * 2);
+  }
+
+  WriteLE(dest, c0, 2);
+  WriteLE(dest + 2, c1, 2);
+  WriteLE(dest + 4, indices, 4);
+}
+
+void EncodeExplicitAlphaBlock(const uint8_t (*texels)[4], uint8_t* dest) {
+  uint64_t alpha = 0;
+  for (int i = 0; i < 16; ++i) {
+    alpha |= (uint64_t)((texels[i][3] * 15 + 127) / 255) << (i * 4);
+  }
+  WriteLE(dest, alpha, 8);
+}
+
+void EncodeInterpolatedAlphaBlock(const uint8_t (*texels)[4], uint8_t* dest) {
+  int a0 = 0;
+  int a1 = 255;
+  for (int i = 0; i < 16; ++i) {
+    a0 = texels[i][3] > a0 ? texels[i][3] : a0;
+    a1 = texels[i][3] < a1 ? texels[i][3] : a1;
+  }
+
+  // With a0 > a1 the palette interpolates six values between the endpoints.
+  int palette[8] = {a0, a1};
+  for (int i = 1; i < 7; ++i) {
+    palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+  }
+  int palette_size = a0 > a1 ? 8 : 1;
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 16; ++i) {
+    int best = 0;
+    for (int p = 1; p < palette_size; ++p) {
+      if (std::abs(texels[i][3] - palette[p]) < std::abs(texels[i][3] - palette[best])) {
+        best = p;
+      }
+    }
+    indices |= (uint64_t)best << (i * 3);
+  }
+
+  dest[0] = (uint8_t)a0;
+  dest[1] = (uint8_t)a1;
+  WriteLE(dest + 2, indices, 6);
+}
+
+}  // namespace
+
+uint32_t DxtBlockSize(DxtFormat format) { return format == DxtFormat::kDxt1 ? 8 : 16; }
+
+std::vector<uint8_t> CompressDxt(const uint8_t* rgba, uint32_t width, uint32_t height, DxtFormat format) {
+  uint32_t blocks_x = (width + 3) / 4;
+  uint32_t blocks_y = (height + 3) / 4;
+  uint32_t block_size = DxtBlockSize(format);
+  std::vector<uint8_t> ret(blocks_x * blocks_y * block_size);
+
+  uint8_t* dest = ret.data();
+  for (uint32_t block_y = 0; block_y < blocks_y; ++block_y) {
+    for (uint32_t block_x = 0; block_x < blocks_x; ++block_x, dest += block_size) {
+      uint8_t texels[16][4];
+      bool transparent[16];
+      for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t x = block_x * 4 + (i & 3);
+        uint32_t y = block_y * 4 + (i >> 2);
+        x = x < width ? x : width - 1;
+        y = y < height ? y : height - 1;
+        memcpy(texels[i], rgba + (y * width + x) * 4, 4);
+        transparent[i] = format == DxtFormat::kDxt1 && texels[i][3] < 128;
+      }
+
+      switch (format) {
+        case DxtFormat::kDxt1:
+          EncodeColorBlock(texels, transparent, dest);
+          break;
+        case DxtFormat::kDxt3:
+          EncodeExplicitAlphaBlock(texels, dest);
+          EncodeColorBlock(texels, transparent, dest + 8);
+          break;
+        case DxtFormat::kDxt5:
+          EncodeInterpolatedAlphaBlock(texels, dest);
+          EncodeColorBlock(texels, transparent, dest + 8);
+          break;
+      }
+    }
+  }
+  return ret;
+}
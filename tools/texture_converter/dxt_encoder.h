@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class DxtFormat {
+  kDxt1,
+  kDxt3,
+  kDxt5,
+};
+
+// Returns the number of bytes in each 4x4 block of `format`.
+uint32_t DxtBlockSize(DxtFormat format);
+
+// Compresses a `width` x `height` image of RGBA texels into 4x4 blocks stored in row order. Blocks
+// that extend past the image repeat its last row and column.
+//
+// DXT1 blocks containing texels with alpha below 128 use the three color mode, with those texels
+// fully transparent.
+std::vector<uint8_t> CompressDxt(const uint8_t* rgba, uint32_t width, uint32_t height, DxtFormat format);
@@ -0,0 +1,221 @@
+// Converts an image into a pre-swizzled or DXT compressed texture container that
+// can be loaded with PBKitSDLGPULoadTextureContainer without any decoding or
+// conversion.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "dxt_encoder.h"
+#include "swizzle.h"
+#include "texture_container.h"
+
+// NV097_SET_TEXTURE_FORMAT_COLOR values.
+static constexpr uint32_t kFormatA8R8G8B8 = 0x06;
+static constexpr uint32_t kFormatA8B8G8R8 = 0x3A;
+static constexpr uint32_t kFormatDxt1 = 0x0C;
+static constexpr uint32_t kFormatDxt3 = 0x0E;
+static constexpr uint32_t kFormatDxt5 = 0x0F;
+
+static constexpr uint32_t kBytesPerPixel = 4;
+
+struct Level {
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> pixels;
+};
+
+static uint32_t NextPowerOf2(uint32_t value) {
+  uint32_t ret = 1;
+  while (ret < value) {
+    ret <<= 1;
+  }
+  return ret;
+}
+
+static uint8_t Log2(uint32_t value) {
+  uint8_t ret = 0;
+  while (value > 1) {
+    value >>= 1;
+    ++ret;
+  }
+  return ret;
+}
+
+// Pads the image to power of two dimensions, replicating the last row and column so that filtering
+// at the edges of the content does not pick up undefined texels.
+static Level PadToPowerOf2(const uint8_t* pixels, uint32_t width, uint32_t height) {
+  Level ret;
+  ret.width = NextPowerOf2(width);
+  ret.height = NextPowerOf2(height);
+  ret.pixels.resize(ret.width * ret.height * kBytesPerPixel);
+
+  for (uint32_t y = 0; y < ret.height; ++y) {
+    const uint8_t* src = pixels + (y < height ? y : height - 1) * width * kBytesPerPixel;
+    uint8_t* dst = ret.pixels.data() + y * ret.width * kBytesPerPixel;
+    memcpy(dst, src, width * kBytesPerPixel);
+    for (uint32_t x = width; x < ret.width; ++x) {
+      memcpy(dst + x * kBytesPerPixel, src + (width - 1) * kBytesPerPixel, kBytesPerPixel);
+    }
+  }
+  return ret;
+}
+
+// Returns the next mipmap level using a 2x2 box filter.
+static Level Downsample(const Level& level) {
+  Level ret;
+  ret.width = level.width > 1 ? level.width / 2 : 1;
+  ret.height = level.height > 1 ? level.height / 2 : 1;
+  ret.pixels.resize(ret.width * ret.height * kBytesPerPixel);
+
+  auto texel = [&level](uint32_t x, uint32_t y) {
+    x = x < level.width ? x : level.width - 1;
+    y = y < level.height ? y : level.height - 1;
+    return level.pixels.data() + (y * level.width + x) * kBytesPerPixel;
+  };
+
+  for (uint32_t y = 0; y < ret.height; ++y) {
+    for (uint32_t x = 0; x < ret.width; ++x) {
+      const uint8_t* p00 = texel(x * 2, y * 2);
+      const uint8_t* p10 = texel(x * 2 + 1, y * 2);
+      const uint8_t* p01 = texel(x * 2, y * 2 + 1);
+      const uint8_t* p11 = texel(x * 2 + 1, y * 2 + 1);
+      uint8_t* dst = ret.pixels.data() + (y * ret.width + x) * kBytesPerPixel;
+      for (uint32_t c = 0; c < kBytesPerPixel; ++c) {
+        dst[c] = (uint8_t)((p00[c] + p10[c] + p01[c] + p11[c] + 2) / 4);
+      }
+    }
+  }
+  return ret;
+}
+
+static void PrintUsage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [--format rgba|bgra|dxt1|dxt3|dxt5] [--mipmaps] <input image> <output file>\n"
+          "  --format   Memory order of the texels (default rgba), or the DXT format to compress to.\n"
+          "  --mipmaps  Generate a full mipmap chain.\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  bool generate_mipmaps = false;
+  bool bgra = false;
+  bool compressed = false;
+  DxtFormat dxt_format = DxtFormat::kDxt1;
+  const char* input_path = nullptr;
+  const char* output_path = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--mipmaps") {
+      generate_mipmaps = true;
+    } else if (arg == "--format" && i + 1 < argc) {
+      std::string format = argv[++i];
+      if (format == "bgra") {
+        bgra = true;
+      } else if (format == "dxt1" || format == "dxt3" || format == "dxt5") {
+        compressed = true;
+        dxt_format = format == "dxt1" ? DxtFormat::kDxt1 : format == "dxt3" ? DxtFormat::kDxt3 : DxtFormat::kDxt5;
+      } else if (format != "rgba") {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    } else if (!input_path) {
+      input_path = argv[i];
+    } else if (!output_path) {
+      output_path = argv[i];
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!input_path || !output_path) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  int width, height, channels;
+  uint8_t* pixels = stbi_load(input_path, &width, &height, &channels, kBytesPerPixel);
+  if (!pixels) {
+    fprintf(stderr, "Failed to load %s: %s\n", input_path, stbi_failure_reason());
+    return 1;
+  }
+
+  if (width > 4096 || height > 4096) {
+    fprintf(stderr, "%s is too large (%dx%d), the maximum is 4096x4096\n", input_path, width, height);
+    stbi_image_free(pixels);
+    return 1;
+  }
+
+  if (bgra) {
+    for (int i = 0; i < width * height; ++i) {
+      std::swap(pixels[i * 4], pixels[i * 4 + 2]);
+    }
+  }
+
+  std::vector<Level> levels;
+  levels.push_back(PadToPowerOf2(pixels, width, height));
+  stbi_image_free(pixels);
+
+  if (generate_mipmaps) {
+    while (levels.back().width > 1 || levels.back().height > 1) {
+      levels.push_back(Downsample(levels.back()));
+    }
+  }
+
+  // DXT blocks are stored in row order rather than swizzled.
+  std::vector<uint8_t> payload;
+  for (auto& level : levels) {
+    size_t offset = payload.size();
+    if (compressed) {
+      auto blocks = CompressDxt(level.pixels.data(), level.width, level.height, dxt_format);
+      payload.insert(payload.end(), blocks.begin(), blocks.end());
+      continue;
+    }
+
+    payload.resize(offset + level.pixels.size());
+    PbkitSdlGpu::swizzle_rect(level.pixels.data(), level.width, level.height, payload.data() + offset,
+                              level.width * kBytesPerPixel, kBytesPerPixel);
+  }
+
+  uint32_t format = bgra ? kFormatA8R8G8B8 : kFormatA8B8G8R8;
+  if (compressed) {
+    format = dxt_format == DxtFormat::kDxt1 ? kFormatDxt1 : dxt_format == DxtFormat::kDxt3 ? kFormatDxt3 : kFormatDxt5;
+  }
+
+  PBKitTextureContainerHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = PBKIT_TEXTURE_CONTAINER_MAGIC;
+  header.version = PBKIT_TEXTURE_CONTAINER_VERSION;
+  header.format = format;
+  header.width = (uint16_t)width;
+  header.height = (uint16_t)height;
+  header.size_u = Log2(levels[0].width);
+  header.size_v = Log2(levels[0].height);
+  header.mip_count = (uint8_t)levels.size();
+  header.bytes_per_pixel = compressed ? 0 : kBytesPerPixel;
+  header.payload_size = (uint32_t)payload.size();
+
+  FILE* output = fopen(output_path, "wb");
+  if (!output) {
+    fprintf(stderr, "Failed to open %s for writing\n", output_path);
+    return 1;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, output) == 1
+            && fwrite(payload.data(), payload.size(), 1, output) == 1;
+  ok = !fclose(output) && ok;
+  if (!ok) {
+    fprintf(stderr, "Failed to write %s\n", output_path);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "vertex_ring_buffer.h"
+#include <windows.h>
+#include "fence.h"
+
+#define MAXRAM 0x03FFAFFF
+
+namespace PbkitSdlGpu {
+
+static constexpr uint32_t kNumSegments = 8;
+static constexpr uint32_t kAlignment = 16;
+
+static uint8_t* ring = nullptr;
+static uint32_t ring_size = 0;
+static uint32_t segment_size = 0;
+static uint32_t head = 0;
+static uint32_t current_segment = 0;
+
+// Fence that must be passed before each segment may be overwritten.
+static uint32_t segment_fences[kNumSegments];
+// Bitmask of segments written since the last fence was inserted.
+static uint32_t dirty_segments = 0;
+
+bool InitVertexRingBuffer(uint32_t size) {
+  size = (size + kNumSegments * kAlignment - 1) & ~(kNumSegments * kAlignment - 1);
+
+  ring = static_cast<uint8_t*>(
+      MmAllocateContiguousMemoryEx(size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
+  if (!ring) {
+    ring_size = 0;
+    return false;
+  }
+
+  ring_size = size;
+  segment_size = size / kNumSegments;
+  head = 0;
+  current_segment = 0;
+  dirty_segments = 0;
+  for (auto& fence : segment_fences) {
+    fence = 0;
+  }
+  return true;
+}
+
+uint8_t* AllocateVertexRingSpace(uint32_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (!size || size > ring_size) {
+    return nullptr;
+  }
+
+  uint32_t start = head;
+  if (start + size > ring_size) {
+    start = 0;
+  }
+
+  uint32_t first_segment = start / segment_size;
+  uint32_t last_segment = (start + size - 1) / segment_size;
+
+  if (first_segment != current_segment || last_segment != current_segment) {
+    // Every draw referencing previous allocations has been pushed by now, so a single fence
+    // covers all of them.
+    if (dirty_segments) {
+      uint32_t fence = InsertFence();
+      for (uint32_t i = 0; i < kNumSegments; ++i) {
+        if (dirty_segments & (1u << i)) {
+          segment_fences[i] = fence;
+        }
+      }
+      dirty_segments = 0;
+    }
+
+    // The segment being appended to is the only one that does not need to be waited on.
+    bool continues_segment = start == head && first_segment == current_segment;
+    for (uint32_t i = first_segment; i <= last_segment; ++i) {
+      if (i == first_segment && continues_segment) {
+        continue;
+      }
+      WaitForFence(segment_fences[i]);
+      segment_fences[i] = 0;
+    }
+    current_segment = last_segment;
+  }
+
+  for (uint32_t i = first_segment; i <= last_segment; ++i) {
+    dirty_segments |= 1u << i;
+  }
+
+  head = start + size;
+  return ring + start;
+}
+
+}  // namespace PbkitSdlGpu
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PbkitSdlGpu {
+
+// Write-combined contiguous memory from which transient vertex data is suballocated.
+//
+// The ring is divided into segments. A fence is inserted whenever allocation moves on to a new
+// segment and a segment is only reused once the GPU has passed the fence covering the last draw
+// that read from it. Data returned by AllocateVertexRingSpace() must therefore be referenced by
+// commands pushed before the next call.
+
+// Allocates the ring. Returns false if the memory could not be allocated.
+bool InitVertexRingBuffer(uint32_t size);
+
+// Returns 16-byte aligned space for `size` bytes of vertex data, blocking if the GPU is still
+// reading from it. Returns NULL if the request is larger than the ring.
+uint8_t* AllocateVertexRingSpace(uint32_t size);
+
+}  // namespace PbkitSdlGpu